@@ -12,11 +12,36 @@ MOC_DIR = $$BUILD_DIR
 RCC_DIR = $$BUILD_DIR
 UI_DIR = $$BUILD_DIR
 
+# Parser and settings statistics are only counted if asked for.
+qcli_statistics: DEFINES += QCLI_STATISTICS
+
 SOURCES += \
     ../src/qclicommandlineparser.cpp \
-    ../src/qclisettings.cpp
+    ../src/qclicommandstring.cpp \
+    ../src/qcliparseresult.cpp \
+    ../src/qcliperfecthash.cpp \
+    ../src/qcliprefixtrie.cpp \
+    ../src/qcliresponsefile.cpp \
+    ../src/qclisettings.cpp \
+    ../src/qclisettingssnapshot.cpp \
+    ../src/qclisettingswatcher.cpp \
+    ../src/qclitokenscan.cpp \
+    ../src/qclivaluebinding.cpp
 
 HEADERS += \
+    ../src/qcliargumentref_p.h \
     ../src/qclicommandlineparser.h \
+    ../src/qclicommandstring_p.h \
+    ../src/qcliparseplan_p.h \
+    ../src/qcliparseresult.h \
+    ../src/qcliparseresult_p.h \
+    ../src/qcliperfecthash_p.h \
+    ../src/qcliprefixtrie_p.h \
+    ../src/qcliresponsefile_p.h \
     ../src/qclisettings.h \
-    ../src/qclioption.h
+    ../src/qclisettingssnapshot_p.h \
+    ../src/qclisettingswatcher_p.h \
+    ../src/qclistatistics_p.h \
+    ../src/qclioption.h \
+    ../src/qclitokenscan_p.h \
+    ../src/qclivaluebinding.h
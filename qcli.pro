@@ -6,3 +6,12 @@ CONFIG(debug, debug|release) {
     SUBDIRS += tests
     tests.depends = src
 }
+
+# The benchmark is built next to the tests. Timings only mean something in
+# release builds, so it can be asked for there with CONFIG+=qcli_benchmark.
+CONFIG(debug, debug|release)|qcli_benchmark {
+    SUBDIRS += benchmark
+    benchmark.file = tests/benchmark.pro
+    benchmark.makefile = Makefile.benchmark
+    benchmark.depends = src
+}
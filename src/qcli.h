@@ -3,6 +3,7 @@
 
 #include "qclicommandlineparser.h"
 #include "qclioption.h"
+#include "qcliparseresult.h"
 #include "qclisettings.h"
 
 #endif // QCLI_H
@@ -0,0 +1,215 @@
+#ifndef QCLIARGUMENTREF_P_H
+#define QCLIARGUMENTREF_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QString>
+#include "qcli_global.h"
+
+namespace QCli
+{
+
+struct TokenScan;
+
+// A non-owning view of (part of) a command line token. The token is either
+// UTF-16 text (e.g. from QCoreApplication::arguments(), or a command string)
+// or a raw local 8-bit buffer (e.g. from argv). Nothing is copied until
+// toString() is called.
+class ArgumentRef
+{
+public:
+    inline ArgumentRef() :
+        string(0), wide(0), narrow(0), length(0) {}
+    inline ArgumentRef(const QString &s) :
+        string(&s), wide(s.constData()), narrow(0), length(s.size()) {}
+    inline ArgumentRef(const QChar *s, int size) :
+        string(0), wide(s), narrow(0), length(size) {}
+    inline ArgumentRef(const char *s) :
+        string(0), wide(0), narrow(s), length(s ? qstrlen(s) : 0) {}
+    inline ArgumentRef(const char *s, int size) :
+        string(0), wide(0), narrow(s), length(size) {}
+
+    inline bool isNull() const { return !wide && !narrow; }
+    inline bool isEmpty() const { return !length; }
+    inline int size() const { return length; }
+
+    inline ushort at(int i) const
+    {
+        return wide ? wide[i].unicode() : ushort(uchar(narrow[i]));
+    }
+
+    // Only ASCII characters are compared. This is all we need to detect the
+    // option prefixes and the '=' separator.
+    inline bool startsWith(const char *prefix) const
+    {
+        int i = 0;
+        for (; prefix[i]; i++)
+        {
+            if (i >= length || at(i) != ushort(uchar(prefix[i])))
+                return false;
+        }
+        return true;
+    }
+
+    inline bool startsWith(const QString &prefix) const
+    {
+        if (prefix.size() > length)
+            return false;
+        const QChar *data = prefix.constData();
+        for (int i = 0; i < prefix.size(); i++)
+        {
+            if (at(i) != data[i].unicode())
+                return false;
+        }
+        return true;
+    }
+
+    inline int indexOf(char c, int from = 0) const
+    {
+        for (int i = from; i < length; i++)
+        {
+            if (at(i) == ushort(uchar(c)))
+                return i;
+        }
+        return -1;
+    }
+
+    inline bool isAscii() const
+    {
+        if (wide)
+            return true;    // Already decoded; nothing to worry about.
+        for (int i = 0; i < length; i++)
+        {
+            if (uchar(narrow[i]) >= 0x80)
+                return false;
+        }
+        return true;
+    }
+
+    bool operator==(const QString &s) const
+    {
+        if (s.size() != length)
+            return false;
+        if (!isAscii())
+            return toString() == s;
+        const QChar *data = s.constData();
+        for (int i = 0; i < length; i++)
+        {
+            if (data[i].unicode() != at(i))
+                return false;
+        }
+        return true;
+    }
+
+    inline ArgumentRef mid(int position) const
+    {
+        Q_ASSERT(position <= length);
+        ArgumentRef ref;
+        ref.length = length - position;
+        if (wide)
+            ref.wide = wide + position;
+        else
+            ref.narrow = narrow + position;
+        return ref;
+    }
+
+    inline ArgumentRef left(int n) const
+    {
+        Q_ASSERT(n <= length);
+        ArgumentRef ref(*this);
+        if (n != length)
+            ref.string = 0;
+        ref.length = n;
+        return ref;
+    }
+
+    // Converts the way QVariant converts strings to bool, which is how the
+    // parser reads the values of switches: empty, "0" and "false" (in any
+    // case) are false, anything else is true.
+    bool toBool() const
+    {
+        if (length == 0 || (length == 1 && at(0) == '0'))
+            return false;
+        static const char False[] = "false";
+        if (length != int(sizeof(False)) - 1)
+            return true;
+        for (int i = 0; i < length; i++)
+        {
+            ushort c = at(i);
+            if (c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+            if (c != ushort(False[i]))
+                return true;
+        }
+        return false;
+    }
+
+    // Whether toString() has to allocate a new string.
+    inline bool needsCopy() const { return !string && !isNull(); }
+
+    // Materializes the view. This shares the source string when the view
+    // covers it entirely, and allocates otherwise.
+    QString toString() const
+    {
+        if (string)
+            return *string;
+        if (wide)
+            return QString(wide, length);
+        if (narrow)
+            return QString::fromLocal8Bit(narrow, length);
+        return QString();
+    }
+
+    // Writes the view into buffer, reusing its capacity. Returns a reference
+    // usable as a hash key, which might be the source string itself.
+    const QString &copyTo(QString *buffer) const
+    {
+        if (string)
+            return *string;
+        if (!isAscii())
+        {
+            *buffer = toString();
+            return *buffer;
+        }
+        buffer->resize(length);
+        QChar *data = buffer->data();
+        for (int i = 0; i < length; i++)
+            data[i] = QChar(at(i));
+        return *buffer;
+    }
+
+    // Appends the view to buffer. Only input that needs decoding goes
+    // through a temporary string.
+    void appendTo(QString *buffer) const
+    {
+        if (!isAscii())
+        {
+            buffer->append(toString());
+            return;
+        }
+        int offset = buffer->size();
+        buffer->resize(offset + length);
+        QChar *data = buffer->data() + offset;
+        for (int i = 0; i < length; i++)
+            data[i] = QChar(at(i));
+    }
+
+private:
+    friend TokenScan scanToken(const ArgumentRef &token);
+
+    const QString *string;
+    const QChar *wide;
+    const char *narrow;
+    int length;
+};
+
+}   // namespace QCli
+
+#endif // QCLIARGUMENTREF_P_H
@@ -1,12 +1,40 @@
 #include "qclicommandlineparser.h"
 #include <cstdio>
+#include <cstring>
+#include <QBitArray>
 #include <QCoreApplication>
 #include <QFile>
+#include <QFileInfo>
+#include <QMetaMethod>
+#include <QMutex>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QSet>
 #include <QStringList>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QVector>
+#include "qcliargumentref_p.h"
+#include "qclicommandstring_p.h"
+#include "qcliparseplan_p.h"
+#include "qcliparseresult.h"
+#include "qcliparseresult_p.h"
+#include "qcliresponsefile_p.h"
 #include "qclisettings.h"
-
+#include "qclistatistics_p.h"
+#include "qclitokenscan_p.h"
+
+#if defined(Q_OS_MAC)
+#  include <crt_externs.h>
+#  define environ (*_NSGetEnviron())
+#elif defined(Q_OS_WIN)
+#  include <cstdlib>
+#  define environ _environ
+#else
+extern char **environ;
+#endif
 
 namespace QCli
 {
@@ -20,6 +48,7 @@ enum Lookup
     GroupNameFound,
     ArgumentFound,
     LookupFailed,
+    LookupAmbiguous,
 };
 }
 
@@ -27,77 +56,206 @@ static void simpleParsingCallback(
         CommandLineParser *parser, CommandLineParser::ParsingResult result,
         const QString &name, QVariant value, bool *stop);
 
-class Option : public QObject
+// Options are kept by value, one after another, and referred to by their
+// slot in that array. Tools with thousands of options would otherwise pay
+// for thousands of small heap objects.
+struct Option
 {
-public:
-    Option(const QString name, const QString &alias, OptionFlags flags,
-           QObject *parent) :
-        QObject(parent), name(name), alias(alias), flags(flags) {}
-
-    Option(const QString name, OptionFlags flags, QObject *parent) :
-        QObject(parent), name(name), alias(), flags(flags) {}
+    Option() : name(), flags(OptionSwitch), negative(false), index(-1) {}
+    Option(const QString &name, OptionFlags flags, bool negative = false) :
+        name(name), flags(flags), negative(negative), index(-1) {}
 
     QString name;
-    QString alias;
-
     OptionFlags flags;
+    bool negative;      // This is the "--no-" form of option name.
+    int index;          // Registration order of the (positive) option name.
+    ValueBinding binding;
 };
 
-class Group : public QSet<Option *>
+// The options of a group, as a bitset over option slots.
+class Group
 {
 public:
-    Group(const QString &name) : QSet<Option *>(), name(name) {}
+    Group(const QString &name) :
+        name(name), subcommand(false), index(-1) {}
 
-    inline void addOption(Option *option)
+    inline void addOption(int slot)
+    {
+        int word = slot / 32;
+        if (word >= members.size())
+            members.resize(word + 1);
+        members[word] |= 1u << (slot % 32);
+    }
+    inline bool hasOption(int slot) const
     {
-        insert(option);
+        int word = slot / 32;
+        return word < members.size() &&
+                (members.at(word) & (1u << (slot % 32)));
     }
-    inline bool hasOption(Option *option)
+    inline void unite(const Group &other)
     {
-        return contains(option);
+        if (members.size() < other.members.size())
+            members.resize(other.members.size());
+        for (int i = 0; i < other.members.size(); i++)
+            members[i] |= other.members.at(i);
     }
 
     QString name;
+    QVector<quint32> members;
+    bool subcommand;    // Selected by a subcommand path, not by its name.
+    int index;          // Index into plan.groupNames, once compiled.
 };
 
+// A subcommand, and how to register its options. They are only registered
+// (into a group named by the path) when the subcommand is first needed.
+struct Subcommand
+{
+    Subcommand(const QString &path,
+               CommandLineParser::SubcommandFactory factory) :
+        path(path), factory(factory), group(0) {}
+
+    QString path;       // Names from the top level down, separated by spaces.
+    CommandLineParser::SubcommandFactory factory;
+    Group *group;       // Once loaded.
+};
+
+// What a token is on its own, regardless of the tokens before it.
 struct OptionResult
 {
-    OptionResult() : option(0), valueString(), lookup(OptionFound) {}
-    Option *option;
-    QString valueString;
+    OptionResult() :
+        entry(-1), group(-1), valueString(), lookup(OptionFound) {}
+    int entry;          // Index into the plan entries.
+    int group;          // Index into the plan group names.
+    ArgumentRef valueString;
     Lookup lookup;
 };
 
+// What classifying tokens needs besides the plan, one per thread: a buffer
+// for decoding lookup keys, so that probing with a token view does not
+// allocate a new key each time, and the thread's share of the statistics.
+struct LookupScratch
+{
+    LookupScratch() : key(), dictionaryProbes(0), groupProbes(0) {}
+
+    QString key;
+    quint64 dictionaryProbes;
+    quint64 groupProbes;
+};
+
+// Argument sources the parser can run over. Both hand out views of their
+// tokens, so no intermediate QStringList is built. The parser only moves
+// forward, looking at most one token ahead, so a source may also produce its
+// tokens as it goes (see ResponseFileSource).
+struct StringListSource
+{
+    StringListSource(const QList<QString> &arguments) : arguments(arguments) {}
+
+    inline bool has(int i) const { return i < arguments.size(); }
+    inline ArgumentRef at(int i) const { return ArgumentRef(arguments.at(i)); }
+    inline bool isError(int) const { return false; }
+    inline int size() const { return arguments.size(); }
+
+    enum { UsesEnvironment = 1 };
+
+    const QList<QString> &arguments;
+};
+
+struct ArgvSource
+{
+    ArgvSource(int argc, char *argv[]) : argc(argc), argv(argv) {}
+
+    inline bool has(int i) const { return i < argc; }
+    inline ArgumentRef at(int i) const { return ArgumentRef(argv[i]); }
+    inline bool isError(int) const { return false; }
+    inline int size() const { return argc; }
+
+    enum { UsesEnvironment = 1 };
+
+    int argc;
+    char **argv;
+};
+
+// What the parser found for one token. Nothing is materialized yet; that is
+// left to the sink the finding is reported to.
+struct Finding
+{
+    Finding() :
+        result(CommandLineParser::OptionFound), token(-1), tokenString(),
+        entry(0), group(-1), valueString(), switchValue(-1) {}
+
+    CommandLineParser::ParsingResult result;
+    int token;                  // Index of the token in the arguments.
+    ArgumentRef tokenString;
+    const PlanEntry *entry;     // The option found, if any.
+    int group;                  // The group selected, for group names.
+    ArgumentRef valueString;
+    int switchValue;            // Boolean value (0 or 1), or -1 if none.
+};
+
+// Reports findings to a callback, one QString name and QVariant value each.
 struct CallbackInvoker
 {
+    enum { UsesVariants = 1 };
+
     CallbackInvoker(CommandLineParser *parser,
                     CommandLineParser::ParsingCallback func) :
-        parser(parser), func(func), method(0, 0)
+        parser(parser), func(func), thunk(0), context(0), method(0, 0)
+    {
+        if (!this->func)
+            this->func = &simpleParsingCallback;
+    }
+
+    CallbackInvoker(CommandLineParser *parser,
+                    CommandLineParser::ParsingThunk thunk, void *context) :
+        parser(parser), func(0), thunk(thunk), context(context), method(0, 0)
     {
-        if (!func)
-            func = &simpleParsingCallback;
     }
 
     CallbackInvoker(CommandLineParser *parser,
                     QObject *obj, const char *callback) :
-        parser(parser), func(0), method(obj, callback)
+        parser(parser), func(0), thunk(0), context(0), method(obj, callback)
     {
-#ifndef QT_NO_DEBUG
-        // Make sure the method signature is correct.
-        QString sig = QString("%1(QCli::CommandLineParser*,"
-                              "QCli::CommandLineParser::ParsingResult,"
-                              "QString,QVariant,bool*)").arg(callback);
-        Q_ASSERT(obj->metaObject()->indexOfMethod(qPrintable(sig)) >= 0);
-#endif
     }
 
-    void invoke(CommandLineParser::ParsingResult result,
-                const QString &name, QVariant value, bool *stop) const
+    inline void report(const Finding &finding, bool *stop) const
+    {
+        // We always report the positive option name (the negative form is
+        // only used internally). Anything else is reported as given.
+        QString name;
+        QVariant value;
+        switch (finding.result)
+        {
+        case CommandLineParser::ArgumentFound:
+            break;
+        case CommandLineParser::GroupMismatch:
+            name = finding.tokenString.toString();
+            break;
+        default:
+            if (finding.entry)
+                name = finding.entry->name;
+            else
+                name = finding.tokenString.toString();
+            break;
+        }
+        if (finding.switchValue >= 0)
+            value = bool(finding.switchValue);
+        else
+            value = finding.valueString.toString();
+        invoke(finding.result, name, value, stop);
+    }
+
+    inline void invoke(CommandLineParser::ParsingResult result,
+                       const QString &name, QVariant value, bool *stop) const
     {
+        if (thunk)
+        {
+            thunk(context, parser, result, name, value, stop);
+            return;
+        }
         if (!func)
         {
-            bool ok = QMetaObject::invokeMethod(
-                        method.obj, method.callback,
+            bool ok = method.method.invoke(
+                        method.obj,
                         Q_ARG(QCli::CommandLineParser *, parser),
                         Q_ARG(QCli::CommandLineParser::ParsingResult, result),
                         Q_ARG(QString, name), Q_ARG(QVariant, value),
@@ -114,14 +272,239 @@ struct CallbackInvoker
 
     CommandLineParser *parser;
     CommandLineParser::ParsingCallback func;
+    CommandLineParser::ParsingThunk thunk;
+    void *context;
     struct Method {
-        Method(QObject *obj, const char *callback) :
-            obj(obj), callback(callback) {}
+        // Resolves the slot once per parse, instead of looking it up by name
+        // for every token.
+        Method(QObject *obj, const char *callback) : obj(obj), method()
+        {
+            if (!obj)
+                return;
+            QString sig = QString("%1(QCli::CommandLineParser*,"
+                                  "QCli::CommandLineParser::ParsingResult,"
+                                  "QString,QVariant,bool*)").arg(callback);
+            const QMetaObject *meta = obj->metaObject();
+            int index = meta->indexOfMethod(
+                        QMetaObject::normalizedSignature(qPrintable(sig)));
+
+            // Make sure the method signature is correct.
+            Q_ASSERT(index >= 0);
+            if (index >= 0)
+                method = meta->method(index);
+        }
         QObject *obj;
-        const char *callback;
+        QMetaMethod method;
     } method;
 };
 
+// Collects findings into the columns of a ParseResult.
+class ParseResultBuilder
+{
+public:
+    enum { UsesVariants = 0 };
+
+    // Empties a result for another parse. Its columns keep their memory,
+    // unless they are shared with a copy of the result.
+    static void reset(ParseResult *result)
+    {
+        ParseResultData *d = result->d.data();
+        d->optionIndexes.resize(0);
+        d->optionValues.resize(0);
+        d->arguments.resize(0);
+        d->errors.resize(0);
+        d->buffer.resize(0);
+        d->group = QString();
+    }
+
+    ParseResultBuilder(ParseResult *result, const ParsePlan &plan,
+                       int count) :
+        d(result->d.data()), plan(plan)
+    {
+        d->optionNames = plan.optionNames;
+        if (count > 0)
+        {
+            d->optionIndexes.reserve(count);
+            d->optionValues.reserve(count);
+            d->arguments.reserve(count);
+            d->buffer.reserve(count * 16);
+        }
+    }
+
+    inline void report(const Finding &finding, bool *) const
+    {
+        switch (finding.result)
+        {
+        case CommandLineParser::OptionFound:
+            if (finding.group >= 0)
+            {
+                // Entering a subcommand may have registered more options.
+                d->group = plan.groupNames.at(finding.group);
+                if (d->optionNames.size() != plan.optionNames.size())
+                    d->optionNames = plan.optionNames;
+                break;
+            }
+            d->optionIndexes.append(finding.entry->option);
+            if (finding.switchValue >= 0)
+                d->optionValues.append(append(finding.switchValue ?
+                                              QLatin1String("true") :
+                                              QLatin1String("false")));
+            else
+                d->optionValues.append(append(finding.valueString));
+            break;
+        case CommandLineParser::ArgumentFound:
+            d->arguments.append(append(finding.valueString));
+            break;
+        default:
+        {
+            ParseResult::Error error;
+            error.result = finding.result;
+            error.token = finding.token;
+            if (finding.entry &&
+                    finding.result != CommandLineParser::GroupMismatch)
+                error.name = append(finding.entry->name);
+            else
+                error.name = append(finding.tokenString);
+            d->errors.append(error);
+            break;
+        }
+        }
+    }
+
+private:
+    inline ParseResult::Span append(const ArgumentRef &s) const
+    {
+        ParseResult::Span span;
+        span.offset = d->buffer.size();
+        s.appendTo(&d->buffer);
+        span.length = d->buffer.size() - span.offset;
+        return span;
+    }
+    inline ParseResult::Span append(const QString &s) const
+    {
+        ParseResult::Span span;
+        span.offset = d->buffer.size();
+        span.length = s.size();
+        d->buffer.append(s);
+        return span;
+    }
+
+    ParseResultData *d;
+    const ParsePlan &plan;
+};
+
+// Everything a parse changes as it goes, carried from one token to the next:
+// whether options have ended, the group selected, and the option (if any)
+// waiting for the next token as its value. The plan is only read, so any
+// number of parses, each with its own state, can run against it at once.
+struct ParseState
+{
+    ParseState() :
+        token(0), hasPending(false), pending(), endOfOptions(false),
+        group(-1), subcommand(0), argumentFound(false), success(true),
+        stopped(false), scratch() {}
+
+    int token;              // Index of the next token.
+    bool hasPending;
+    Finding pending;
+    bool endOfOptions;
+    int group;              // Index into the plan group names, or -1.
+    const Subcommand *subcommand;   // Innermost subcommand entered.
+    bool argumentFound;     // Ends the subcommand path.
+    bool success;
+    bool stopped;
+    LookupScratch scratch;
+#ifdef QCLI_STATISTICS
+    CommandLineParser::Statistics statistics;
+#endif
+};
+
+// An incremental parse started by CommandLineParser::beginFeed().
+struct FeedState
+{
+    FeedState(const CallbackInvoker &invoker, bool keepResult) :
+        state(), invoker(invoker), keepResult(keepResult), finished(false),
+        result() {}
+
+    ParseState state;
+    CallbackInvoker invoker;
+    bool keepResult;
+    bool finished;
+    ParseResult result;
+};
+
+// Reports to the callback of a feed, and to its result if it is kept.
+struct FeedSink
+{
+    enum { UsesVariants = 1 };
+
+    FeedSink(FeedState *feed, const ParsePlan &plan) : feed(feed), plan(plan) {}
+
+    inline void report(const Finding &finding, bool *stop) const
+    {
+        if (feed->keepResult)
+            ParseResultBuilder(&feed->result, plan, 0).report(finding, stop);
+        feed->invoker.report(finding, stop);
+    }
+
+    FeedState *feed;
+    const ParsePlan &plan;
+};
+
+// Marks a parse as running on the current thread, for as long as it is in
+// scope, so that currentGroupName() called from a callback sees the group of
+// that parse, and not of another one running on the same parser elsewhere.
+// Parses can nest (a callback may parse again), so each keeps the previous.
+// QThreadStorage deletes what it holds whenever it is set again, so each
+// thread gets one holder for the innermost parse, created on its first parse.
+struct ActiveParse;
+struct ActiveParseStack
+{
+    ActiveParseStack() : top(0) {}
+    ActiveParse *top;
+};
+Q_GLOBAL_STATIC(QThreadStorage<ActiveParseStack *>, activeParses)
+
+struct ActiveParse
+{
+    ActiveParse(const CommandLineParserPrivate *d, const ParseState *state) :
+        d(d), state(state), stack(localStack()), previous(stack->top)
+    {
+        stack->top = this;
+    }
+
+    ~ActiveParse()
+    {
+        stack->top = previous;
+    }
+
+    static ActiveParseStack *localStack()
+    {
+        QThreadStorage<ActiveParseStack *> *storage = activeParses();
+        if (!storage->hasLocalData())
+            storage->setLocalData(new ActiveParseStack);
+        return storage->localData();
+    }
+
+    static const ParseState *find(const CommandLineParserPrivate *d)
+    {
+        if (!activeParses()->hasLocalData())
+            return 0;
+        for (ActiveParse *p = activeParses()->localData()->top; p;
+             p = p->previous)
+        {
+            if (p->d == d)
+                return p->state;
+        }
+        return 0;
+    }
+
+    const CommandLineParserPrivate *d;
+    const ParseState *state;
+    ActiveParseStack *stack;
+    ActiveParse *previous;
+};
+
 class CommandLineParserPrivate
 {
     Q_DECLARE_PUBLIC(CommandLineParser)
@@ -131,30 +514,141 @@ public:
     CommandLineParserPrivate(CommandLineParser *q);
     ~CommandLineParserPrivate();
 
-    OptionResult findOption(const QString &optionString);
-    inline bool isGroupName(const QString &optionString);
-    inline bool isOptionNameLike(const QString &optionString);
-    inline void insertOption(const QString &key, Option *option);
+    // Only reads the plan, so tokens can be classified on any thread, each
+    // with its own scratch buffer for lookups.
+    OptionResult classify(const ArgumentRef &optionString,
+                          LookupScratch *scratch) const;
+    inline int lookup(const ArgumentRef &key, bool ascii, bool allowPrefix,
+                      QString *scratch) const;
+    void compilePlan();
+    inline int addOptionSlot(const Option &option);
+    inline void insertOption(const QString &key, int slot);
+
+    inline int registerOptionName(const QString &name);
+
+    // The parser proper: a state machine taking one token at a time, and
+    // reporting a Finding to sink for each token (or pair of tokens, for an
+    // option and its value) as soon as it is complete.
+    void beginParse(ParseState *state, int firstToken);
+    void endParse(const ParseState &state);
+    template <typename Sink>
+    void step(ParseState *state, const ArgumentRef &token, bool error,
+              const Sink &sink);
+    template <typename Sink>
+    void step(ParseState *state, const ArgumentRef &token, bool error,
+              const OptionResult &result, const Sink &sink);
+    template <typename Sink>
+    void finishParse(ParseState *state, const Sink &sink);
+    template <typename Sink>
+    void parseEnvironment(ParseState *state, const Sink &sink,
+                          bool afterArguments);
+    static inline void setNoValue(Finding *pending);
+    template <typename Sink>
+    inline void deliver(ParseState *state, Finding &finding, const Sink &sink);
+
+    // Loading a subcommand registers its options, and those of subcommands
+    // enclosing it; the plan is compiled again before it is used next.
+    Group *loadSubcommand(Subcommand *subcommand);
+    Subcommand *findSubcommand(ParseState *state, const ArgumentRef &token);
+
+    QStringList complete(const QList<QString> &words);
+
+    // Runs the parser over the arguments.
+    template <typename Source, typename Sink>
+    bool parse(const Source &arguments, const Sink &sink);
+
+    // Same, but classifies the tokens on several threads first, a block at a
+    // time, and then runs the state machine over the classified tokens. Only
+    // for sources that know their size, and can be read from any thread.
+    template <typename Source, typename Sink>
+    bool parseParallel(const Source &arguments, const Sink &sink, int threads);
+    template <typename Source>
+    void classifyParallel(ParseState *state, const Source &arguments,
+                          int begin, int end, OptionResult *results,
+                          int threads);
+    inline int threadCount() const;
+
+    // Same, expanding response files if enabled.
+    template <typename Source, typename Sink>
+    inline bool parseArguments(const Source &arguments, const Sink &sink)
+    {
+        if (!responseFilesEnabled)
+        {
+            // Entering a subcommand changes the plan in the middle of the
+            // parse, which classifying ahead cannot know about.
+            int threads = threadCount();
+            if (threads > 1 && subcommands.isEmpty() &&
+                    arguments.size() >= parallelThreshold)
+                return parseParallel(arguments, sink, threads);
+            return parse(arguments, sink);
+        }
+        return parse(ResponseFileSource<Source>(arguments, responseFileFormat,
+                                                responseFileSizeLimit),
+                     sink);
+    }
 
-    bool parse(const QStringList &arguments, const CallbackInvoker &invoker);
+    // Same, for a command string.
+    template <typename Sink>
+    bool parseCommand(const QString &command, const Sink &sink);
 
-    inline bool booleanize(const QString &str);
+    static inline bool assignBoundValue(const Finding &finding);
+    static bool booleanize(const ArgumentRef &str);
+    static bool equalsIgnoreCase(const ArgumentRef &str, const char *latin1);
 
-    QHash<QString, Option *> options;
+    QVector<Option> optionSlots;
+    QHash<QString, int> options;    // Slots by key.
     QHash<QString, Group *> groups;
+    QHash<QString, Subcommand *> subcommands;   // By path.
+
+    // Option names in registration order, and the other way round.
+    QVector<QString> optionNames;
+    QHash<QString, int> optionIndexes;
+
+    // Compiled from options and groups by freeze(), or before parsing if
+    // something was registered since. Parsing only ever reads the plan.
+    ParsePlan plan;
+    bool planDirty;
+    bool abbreviationsEnabled;
+
+    bool responseFilesEnabled;
+    int responseFileFormat;
+    qint64 responseFileSizeLimit;
+
+    QString environmentPrefix;
+    QHash<QString, QString> environmentVariables;   // By option name.
+    int environmentPrecedence;
+
+    int parsingThreadCount;
+    int parallelThreshold;
+    QThreadPool *threadPool;    // Only if more than one thread is used.
+
+    // Parses add their counts when they end.
+    CommandLineParser::Statistics statistics;
+#ifdef QCLI_STATISTICS
+    QMutex statisticsMutex;
+#endif
+
     Settings *settings;
+    FeedState *feed;
 
+    // Group options are registered into, and group selected by the parse
+    // that ended last (an index into plan.groupNames).
     Group *currentGroup;
-
-    QHash<QString, QVariant> parsedOptions;
-    QList<QVariant> parsedArguments;
+    QAtomicInt lastGroup;
 
     QIODevice *outDevice;
     QIODevice *errDevice;
 };
 
 CommandLineParserPrivate::CommandLineParserPrivate(CommandLineParser *q) :
-    q_ptr(q), currentGroup(0), outDevice(0), errDevice(0)
+    q_ptr(q), planDirty(false), abbreviationsEnabled(false),
+    responseFilesEnabled(false),
+    responseFileFormat(CommandLineParser::ResponseFileWhitespace),
+    responseFileSizeLimit(256 << 20),
+    environmentPrecedence(CommandLineParser::EnvironmentOverSettings),
+    parsingThreadCount(1),
+    parallelThreshold(16384), threadPool(0), settings(0), feed(0),
+    currentGroup(0), lastGroup(-1), outDevice(0), errDevice(0)
 {
     QFile *outFile = new QFile();
     outFile->open(stdout, QIODevice::WriteOnly);
@@ -168,290 +662,968 @@ CommandLineParserPrivate::CommandLineParserPrivate(CommandLineParser *q) :
 CommandLineParserPrivate::~CommandLineParserPrivate()
 {
     qDeleteAll(groups);
+    qDeleteAll(subcommands);
+    delete feed;
+    delete threadPool;
     delete outDevice;
     delete errDevice;
 }
 
-OptionResult CommandLineParserPrivate::findOption(const QString &optionString)
+OptionResult CommandLineParserPrivate::classify(
+        const ArgumentRef &optionString, LookupScratch *scratch) const
 {
+    // Prefixes, the equal sign and the need to decode are all found in one
+    // pass, instead of scanning the token again for each.
+    TokenScan scan = scanToken(optionString);
     OptionResult result;
-    if (optionString.startsWith(OptionNamePrefix))
+    if (scan.dashes == scan.length && scan.dashes > 0)
     {
-        if (optionString.size() == 2)
-        {
-            result.lookup = EndOfOptionsFound;
-            return result;
-        }
+        result.lookup = EndOfOptionsFound;
+        return result;
     }
-    else if (optionString.startsWith(OptionAliasPrefix))
+    if (!scan.dashes)
     {
-        if (optionString.size() == 1)
+        QCLI_COUNT(scratch->groupProbes);
+        int index = lookup(optionString, scan.ascii, false, &scratch->key);
+        if (index >= 0)
+            result.group = plan.entries.at(index).group;
+        if (result.group >= 0)
         {
-            result.lookup = EndOfOptionsFound;
-            return result;
+            result.lookup = GroupNameFound;
+        }
+        else
+        {
+            result.lookup = ArgumentFound;
+            result.valueString = optionString;
         }
-    }
-    else if (isGroupName(optionString))
-    {
-        currentGroup = groups.value(optionString);
-        result.lookup = GroupNameFound;
-        return result;
-    }
-    else
-    {
-        result.lookup = ArgumentFound;
-        result.valueString = optionString;
         return result;
     }
 
     // Find first occurance of '=' (not last; we can control the option name,
     // but should allow the user to use the equal sign in value inputs).
-    int equalSignLocation = optionString.indexOf('=');
+    ArgumentRef key = optionString;
+    int equalSignLocation = scan.equalSign;
     if (equalSignLocation != -1)
     {
-        if (equalSignLocation + 1 < optionString.size())
-            result.valueString = optionString.mid(equalSignLocation + 1);
-        else
-            result.valueString = "";
-        result.option = options.value(optionString.left(equalSignLocation));
+        // An empty (but not null) view if nothing follows the equal sign.
+        result.valueString = optionString.mid(equalSignLocation + 1);
+        key = optionString.left(equalSignLocation);
     }
-    else
+
+    // Only long option names may be abbreviated.
+    bool allowPrefix = abbreviationsEnabled && scan.dashes == 2;
+    QCLI_COUNT(scratch->dictionaryProbes);
+    int index = lookup(key, scan.ascii, allowPrefix, &scratch->key);
+    if (index == PrefixTrie::Ambiguous)
     {
-        result.option = options.value(optionString);
+        result.lookup = LookupAmbiguous;
+        return result;
     }
-    result.lookup = result.option ? OptionFound : LookupFailed;
+    if (index >= 0 && plan.entries.at(index).kind == PlanEntry::OptionEntry)
+        result.entry = index;
+    result.lookup = result.entry >= 0 ? OptionFound : LookupFailed;
     return result;
 }
 
-bool CommandLineParserPrivate::isGroupName(const QString &optionString)
+int CommandLineParserPrivate::lookup(const ArgumentRef &key, bool ascii,
+                                     bool allowPrefix, QString *scratch) const
 {
-    if (groups.contains(optionString))
-        return true;
-    return false;
+    // The dictionary works on code units, so local 8-bit input needs decoding
+    // first unless it is plain ASCII.
+    ArgumentRef decoded = key;
+    if (!ascii)
+        decoded = ArgumentRef(key.copyTo(scratch));
+
+    int index = PrefixTrie::NotFound;
+    if (plan.dictionaryValid)
+        index = plan.dictionary.indexOf(decoded);
+    else
+        index = plan.prefixes.find(decoded);
+    if (index < 0 && allowPrefix)
+        index = plan.prefixes.findPrefix(decoded);
+    return index;
 }
 
-bool CommandLineParserPrivate::isOptionNameLike(const QString &optionString)
+void CommandLineParserPrivate::compilePlan()
 {
-    if (optionString.startsWith(OptionNamePrefix))
-        return true;
-    if (optionString.startsWith(OptionAliasPrefix))
-        return true;
-    return false;
+#ifdef QCLI_STATISTICS
+    QElapsedTimer timer;
+    timer.start();
+#endif
+    plan = ParsePlan();
+    lastGroup.fetchAndStoreRelaxed(-1);
+
+    int count = options.size() + groups.size();
+    QVector<QString> keys;
+    QVector<int> keySlots;
+    keys.reserve(count);
+    keySlots.reserve(count);
+    plan.entries.reserve(count);
+
+    // Number the groups, and turn the option bitset of each group around
+    // into a group bitset for each option slot.
+    plan.groupWords = (groups.size() + 31) / 32;
+    QVector<quint32> slotGroups(optionSlots.size() * plan.groupWords, 0);
+    QBitArray grouped(optionSlots.size());
+    QBitArray unscoped(optionSlots.size());
+    typedef QHash<QString, Group *>::const_iterator GroupIter;
+    for (GroupIter it = groups.constBegin(); it != groups.constEnd(); it++)
+    {
+        int index = plan.groupNames.size();
+        plan.groupNames.append(it.key());
+        Group *group = it.value();
+        group->index = index;
+        for (int word = 0; word < group->members.size(); word++)
+        {
+            quint32 bits = group->members.at(word);
+            for (int slot = word * 32; bits; slot++, bits >>= 1)
+            {
+                if (!(bits & 1))
+                    continue;
+                slotGroups[slot * plan.groupWords + index / 32] |=
+                        1u << (index % 32);
+                grouped.setBit(slot);
+                if (!group->subcommand)
+                    unscoped.setBit(slot);
+            }
+        }
+    }
+
+    typedef QHash<QString, int>::const_iterator OptionIter;
+    for (OptionIter it = options.constBegin(); it != options.constEnd(); it++)
+    {
+        const Option &option = optionSlots.at(it.value());
+        PlanEntry entry;
+        entry.name = option.name;
+        entry.mode = (int)option.flags & ~OptionNegativeSwitch;
+        entry.negative = option.negative;
+        entry.scoped = grouped.testBit(it.value()) &&
+                !unscoped.testBit(it.value());
+        entry.option = option.index;
+        entry.binding = option.binding;
+        plan.entries.append(entry);
+        keys.append(it.key());
+        keySlots.append(it.value());
+    }
+
+    // Option keys win should a group be named like one; such a group could
+    // never be selected anyway, since the token would look like an option.
+    // Subcommands are looked up by path instead, in the context of the
+    // subcommand entered before.
+    for (GroupIter it = groups.constBegin(); it != groups.constEnd(); it++)
+    {
+        if (options.contains(it.key()) || it.value()->subcommand)
+            continue;
+        PlanEntry entry;
+        entry.name = it.key();
+        entry.kind = PlanEntry::GroupEntry;
+        entry.group = it.value()->index;
+        plan.entries.append(entry);
+        keys.append(it.key());
+        keySlots.append(-1);
+    }
+
+    plan.groupBits.fill(0, plan.entries.size() * plan.groupWords);
+    for (int i = 0; i < keySlots.size(); i++)
+    {
+        if (keySlots.at(i) < 0)
+            continue;
+        const quint32 *from =
+                slotGroups.constData() + keySlots.at(i) * plan.groupWords;
+        quint32 *bits = plan.groupBits.data() + i * plan.groupWords;
+        for (int word = 0; word < plan.groupWords; word++)
+            bits[word] = from[word];
+    }
+
+    // Environment variables, each naming the positive form of an option.
+    if (!environmentPrefix.isEmpty() || !environmentVariables.isEmpty())
+    {
+        QVector<QString> variables;
+        QSet<QString> seen;
+        for (int i = 0; i < plan.entries.size(); i++)
+        {
+            const PlanEntry &entry = plan.entries.at(i);
+            const QString &key = keys.at(i);
+            if (entry.kind != PlanEntry::OptionEntry || entry.negative ||
+                    entry.scoped || key.size() != entry.name.size() + 2 ||
+                    !key.startsWith(OptionNamePrefix))
+                continue;
+            QString variable;
+            typedef QHash<QString, QString>::const_iterator VariableIter;
+            VariableIter it = environmentVariables.constFind(entry.name);
+            if (it != environmentVariables.constEnd())
+            {
+                variable = it.value();
+            }
+            else if (!environmentPrefix.isEmpty())
+            {
+                variable = environmentPrefix + entry.name.toUpper();
+                variable.replace(QChar('-'), QChar('_'));
+            }
+            if (variable.isEmpty() || seen.contains(variable))
+                continue;
+            seen.insert(variable);
+            variables.append(variable);
+            plan.environmentEntries.append(i);
+        }
+        plan.environment.build(variables);
+    }
+
+    plan.optionNames = optionNames;
+    plan.keys = keys;
+    plan.dictionaryValid = plan.dictionary.build(keys);
+    plan.prefixes.build(keys);
+    planDirty = false;
+
+#ifdef QCLI_STATISTICS
+    // Parses on other threads add to the statistics under the lock, too.
+    QMutexLocker locker(&statisticsMutex);
+    statistics.compileTime += timer.nsecsElapsed();
+#endif
+}
+
+int CommandLineParserPrivate::addOptionSlot(const Option &option)
+{
+    int slot = optionSlots.size();
+    optionSlots.append(option);
+    if (currentGroup)
+        currentGroup->addOption(slot);
+    return slot;
 }
 
-void CommandLineParserPrivate::insertOption(const QString &key, Option *option)
+void CommandLineParserPrivate::insertOption(const QString &key, int slot)
 {
     if (options.contains(key))
     {
         QTextStream err(errDevice);
         err << "Replacing existing option " << key << "!" << endl;
     }
-    options.insert(key, option);
+    options.insert(key, slot);
+    planDirty = true;
 }
 
-bool CommandLineParserPrivate::parse(
-        const QStringList &arguments, const CallbackInvoker &invoker)
+int CommandLineParserPrivate::registerOptionName(const QString &name)
 {
-    Q_ASSERT(arguments.size() > 0);
+    int index = optionIndexes.value(name, -1);
+    if (index < 0)
+    {
+        index = optionNames.size();
+        optionNames.append(name);
+        optionIndexes.insert(name, index);
+    }
+    return index;
+}
 
-    currentGroup = 0;
-    parsedOptions.clear();
-    parsedArguments.clear();
+void CommandLineParserPrivate::beginParse(ParseState *state, int firstToken)
+{
+    if (planDirty)
+        compilePlan();
+    *state = ParseState();
+    state->token = firstToken;
+}
 
-    bool success = true;
-    bool stop = false;
-    CommandLineParser::ParsingResult parsingResult;
+Group *CommandLineParserPrivate::loadSubcommand(Subcommand *subcommand)
+{
+    if (subcommand->group)
+        return subcommand->group;
 
-    // Skips the first argument (which is the command name).
-    QStringList::const_iterator it = arguments.constBegin() + 1;
-    while (it < arguments.constEnd())
+    // Options of enclosing subcommands are valid in nested ones, too.
+    Group *group = groups.value(subcommand->path);
+    if (!group)
+    {
+        group = new Group(subcommand->path);
+        groups.insert(subcommand->path, group);
+    }
+    group->subcommand = true;
+    subcommand->group = group;
+    int space = subcommand->path.lastIndexOf(QChar(' '));
+    Subcommand *parent = space < 0 ? 0 :
+            subcommands.value(subcommand->path.left(space));
+    if (parent)
+        group->unite(*loadSubcommand(parent));
+
+    Group *previous = currentGroup;
+    currentGroup = group;
+    if (subcommand->factory)
+        subcommand->factory(q_ptr, subcommand->path);
+    currentGroup = previous;
+    planDirty = true;
+    return group;
+}
+
+Subcommand *CommandLineParserPrivate::findSubcommand(
+        ParseState *state, const ArgumentRef &token)
+{
+    QString &path = state->scratch.key;
+    path.resize(0);
+    if (state->subcommand)
+    {
+        path.append(state->subcommand->path);
+        path.append(QChar(' '));
+    }
+    token.appendTo(&path);
+    return subcommands.value(path);
+}
+
+// Follows the words before the last the way the parser would, without
+// reporting anything, to find what the last word can be.
+QStringList CommandLineParserPrivate::complete(const QList<QString> &words)
+{
+    QStringList candidates;
+    if (words.size() < 2)
+        return candidates;
+
+    ParseState state;
+    beginParse(&state, 1);
+    bool valuePending = false;
+    for (int i = 1; i < words.size() - 1 && !state.endOfOptions; i++)
     {
-        OptionResult result = findOption(*it);
+        ArgumentRef token(words.at(i));
+        OptionResult result = classify(token, &state.scratch);
+        if (valuePending)
+        {
+            valuePending = false;
+            if (result.lookup == ArgumentFound)
+                continue;
+        }
         switch (result.lookup)
         {
-        // End of options detected. Skip this one and end option parsing.
         case EndOfOptionsFound:
-            it++;
-            stop = true;
+            state.endOfOptions = true;
             break;
-        // This is a group name. Continue with next.
         case GroupNameFound:
-            invoker.invoke(CommandLineParser::OptionFound, *it,
-                           QVariant(true), &stop);
-            it++;
-            continue;
-        default:
+            state.group = result.group;
             break;
-        }
-        if (stop)
-            break;
-
-        QString name;
-        QVariant value = result.valueString;
-        parsingResult = CommandLineParser::OptionFound;
-
-        switch (result.lookup)
+        case OptionFound:
         {
-        case LookupFailed:      // Is option-like, but not a known option.
-            name = *it;
-            parsingResult = CommandLineParser::OptionUnknown;
-            success = false;
-            break;
-
-        case ArgumentFound:     // Is not option-like.
-            value = *it;
-            parsingResult = CommandLineParser::ArgumentFound;
-            parsedArguments.append(value);
+            const PlanEntry &entry = plan.entries.at(result.entry);
+            valuePending = !entry.negative && entry.mode != OptionSwitch &&
+                    result.valueString.isNull();
             break;
-
-        default:
-            Q_ASSERT(result.option);
-
-            // Is an option, but not found in current group.
-            if (currentGroup && !currentGroup->hasOption(result.option))
-            {
-                name = *it;
-                parsingResult = CommandLineParser::GroupMismatch;
-                success = false;
-            }
-            // Lookup successful. Parse!
-            else
+        }
+        case ArgumentFound:
+            if (!subcommands.isEmpty() && !state.argumentFound)
             {
-                // Note that we always report positive option name (we only use
-                // negative form internally)!
-                name = result.option->name;
-
-                // Option is a negative boolean "switch": If we already have a
-                // value (via --name=value syntax), convert it to inverted
-                // boolean, otherwise return false.
-                QString neg = QString("%1no-%2").arg(OptionNamePrefix, name);
-                if ((*it).startsWith(neg))
-                {
-                    if (result.valueString.isNull())
-                        value = false;
-                    else
-                        value = !booleanize(result.valueString);
-                }
-
-                // After clearing the negative switch, this should be one of
-                // OptionSwitch, OptionValueRequired, or OptionValueOptional.
-                switch ((int)result.option->flags & ~OptionNegativeSwitch)
+                Subcommand *subcommand = findSubcommand(&state, token);
+                if (subcommand)
                 {
-                case OptionValueRequired:
-                    // Check next option. If it "looks like" an option (i.e.
-                    // starts with -- or - or is one of option group names),
-                    // notify about missing value. Also notify about missing
-                    // value if this is the last option. If we already have the
-                    // value (via --name=value syntax), no need to search.
-                    if (value.isNull())
-                    {
-                        if (it + 1 < arguments.constEnd())
-                        {
-                            const QString &next = *(it + 1);
-                            if (isOptionNameLike(next) || isGroupName(next))
-                            {
-                                parsingResult = CommandLineParser::ValueMissing;
-                            }
-                            else
-                            {
-                                it++;
-                                value = next;
-                            }
-                        }
-                        else
-                        {
-                            parsingResult = CommandLineParser::ValueMissing;
-                        }
-                    }
-                    break;
-                case OptionValueOptional:
-                    // Options can have optional value: Check next option. If it
-                    // "looks like" a value (i.e. doesn't start with -- or -),
-                    // use it. Otherwie assume true (the same if there's no more
-                    // option). If we already have the value (via --name=value
-                    // syntax), no need to search.
-                    if (value.isNull())
-                    {
-                        if (it + 1 < arguments.constEnd())
-                        {
-                            const QString &next = *(it + 1);
-                            if (isOptionNameLike(next) || isGroupName(next))
-                            {
-                                value = true;
-                            }
-                            else
-                            {
-                                it++;
-                                value = next;
-                            }
-                        }
-                        else
-                        {
-                            value = true;
-                        }
-                    }
-                    break;
-                case OptionSwitch:
-                    // Option is a negative boolean "switch": If we already have
-                    // a value (via --name=value syntax), convert it to boolean,
-                    // otherwise return true.
-                    if (!value.isNull())            // There is a value already.
-                        value = value.toBool();     // Normalize to boolean.
-                    else if (result.valueString.isNull())
-                        value = true;
-                    else
-                        value = !booleanize(result.valueString);
-                    break;
-                default:
-                    parsingResult = CommandLineParser::OptionUnknown;
+                    Group *group = loadSubcommand(subcommand);
+                    if (planDirty)
+                        compilePlan();
+                    state.subcommand = subcommand;
+                    state.group = group->index;
                     break;
                 }
             }
+            state.argumentFound = true;
+            break;
+        default:
             break;
         }
+    }
 
-        // Prepare remaining parameters and notify observer. If observer stops
-        // the operation, quit immediately.
-        invoker.invoke(parsingResult, name, value, &stop);
-        if (stop)
-            return false;
+    // Values and arguments are up to the shell. Options still end a value
+    // that has not been given yet.
+    const QString &word = words.last();
+    bool optionLike = word.startsWith(QChar('-'));
+    if (state.endOfOptions || (valuePending && !optionLike))
+        return candidates;
 
-        // Remember parsed option and continue with next one.
-        if (!name.isNull() && !value.isNull())
-            parsedOptions.insert(name, value);
-        it++;
+    if (optionLike)
+    {
+        if (word.contains(QChar('=')))
+            return candidates;
+        for (int i = 0; i < plan.entries.size(); i++)
+        {
+            const PlanEntry &entry = plan.entries.at(i);
+            if (entry.kind != PlanEntry::OptionEntry ||
+                    !plan.keys.at(i).startsWith(word))
+                continue;
+            if (state.group >= 0 ? plan.isInGroup(i, state.group)
+                                 : !entry.scoped)
+                candidates.append(plan.keys.at(i));
+        }
     }
-
-    // Prepare arguments (arguments are command line options after options).
-    parsingResult = CommandLineParser::ArgumentFound;
-    for (; it < arguments.constEnd(); it++)
+    else
     {
-        QVariant value = *it;
-        bool stop = false;
-        parsedArguments.append(value);
-        invoker.invoke(parsingResult, QString(), value, &stop);
-        if (stop)
-            return false;
+        for (int i = 0; i < plan.entries.size(); i++)
+        {
+            if (plan.entries.at(i).kind == PlanEntry::GroupEntry &&
+                    plan.keys.at(i).startsWith(word))
+                candidates.append(plan.keys.at(i));
+        }
+
+        // Subcommands directly below the one entered.
+        if (!state.argumentFound)
+        {
+            QString prefix;
+            if (state.subcommand)
+                prefix = state.subcommand->path + QChar(' ');
+            typedef QHash<QString, Subcommand *>::const_iterator Iter;
+            for (Iter it = subcommands.constBegin();
+                 it != subcommands.constEnd(); it++)
+            {
+                const QString &path = it.key();
+                if (!path.startsWith(prefix) ||
+                        path.indexOf(QChar(' '), prefix.size()) >= 0)
+                    continue;
+                QString name = path.mid(prefix.size());
+                if (name.startsWith(word))
+                    candidates.append(name);
+            }
+        }
     }
-    return success;
+    candidates.sort();
+    return candidates;
 }
 
-bool CommandLineParserPrivate::booleanize(const QString &str)
+void CommandLineParserPrivate::endParse(const ParseState &state)
 {
-    QString stripped = str.trimmed();
-    bool ok = false;
-
-    // Try integer parsing.
-    qlonglong v = stripped.toLongLong(&ok);
-    if (ok)
-        return v;
-
-    // Try boolean parsing.
-    if (stripped.compare("false", Qt::CaseInsensitive) == 0)
-        return false;
+    lastGroup.fetchAndStoreRelaxed(state.group);
+#ifdef QCLI_STATISTICS
+    const CommandLineParser::Statistics &counts = state.statistics;
+    QMutexLocker locker(&statisticsMutex);
+    statistics.parses += counts.parses;
+    statistics.tokens += counts.tokens;
+    statistics.dictionaryProbes += state.scratch.dictionaryProbes;
+    statistics.groupProbes += state.scratch.groupProbes;
+    statistics.lookaheadChecks += counts.lookaheadChecks;
+    for (int i = 0; i < CommandLineParser::Statistics::ResultCount; i++)
+        statistics.findings[i] += counts.findings[i];
+    statistics.variantConversions += counts.variantConversions;
+    statistics.stringAllocations += counts.stringAllocations;
+    statistics.classifyTime += counts.classifyTime;
+    statistics.parseTime += counts.parseTime;
+    statistics.reportTime += counts.reportTime;
+#endif
+}
 
-    // Judge by string length.
-    return stripped.size();
+template <typename Sink>
+void CommandLineParserPrivate::step(ParseState *state, const ArgumentRef &token,
+                                    bool error, const Sink &sink)
+{
+    // Nothing needs to be looked up after the end of options, unless the
+    // token may be the value of an option.
+    OptionResult result;
+    if (!error && (state->hasPending || !state->endOfOptions))
+        result = classify(token, &state->scratch);
+    step(state, token, error, result, sink);
+}
+
+template <typename Sink>
+void CommandLineParserPrivate::step(ParseState *state, const ArgumentRef &token,
+                                    bool error, const OptionResult &result,
+                                    const Sink &sink)
+{
+    if (state->stopped)
+        return;
+
+    QCLI_COUNT(state->statistics.tokens);
+    Finding finding;
+    finding.token = state->token++;
+    finding.tokenString = token;
+
+    // An option waiting for a value takes this token, unless it "looks like"
+    // an option (i.e. starts with -- or - or is one of option group names).
+    if (state->hasPending)
+    {
+        QCLI_COUNT(state->statistics.lookaheadChecks);
+        state->hasPending = false;
+        Finding &pending = state->pending;
+        if (!error && result.lookup == ArgumentFound)
+        {
+            pending.valueString = token;
+            deliver(state, pending, sink);
+            return;
+        }
+        setNoValue(&pending);
+        deliver(state, pending, sink);
+        if (state->stopped)
+            return;
+    }
+
+    if (error)
+    {
+        finding.result = CommandLineParser::ResponseFileError;
+        state->success = false;
+        deliver(state, finding, sink);
+        return;
+    }
+
+    // Arguments (arguments are command line options after options).
+    if (state->endOfOptions)
+    {
+        finding.result = CommandLineParser::ArgumentFound;
+        finding.valueString = token;
+        deliver(state, finding, sink);
+        return;
+    }
+
+    // The value is kept as a view into the token; it is up to the sink
+    // whether (and how) to turn it into a string.
+    ArgumentRef &valueString = finding.valueString;
+    valueString = result.valueString;
+
+    switch (result.lookup)
+    {
+    // End of options detected. Skip this one and end option parsing.
+    case EndOfOptionsFound:
+        state->endOfOptions = true;
+        return;
+
+    // This is a group name. Continue with next.
+    case GroupNameFound:
+        state->group = result.group;
+        finding.group = state->group;
+        finding.switchValue = 1;
+        break;
+
+    case LookupFailed:      // Is option-like, but not a known option.
+        finding.result = CommandLineParser::OptionUnknown;
+        state->success = false;
+        break;
+
+    case LookupAmbiguous:   // Abbreviates more than one option.
+        finding.result = CommandLineParser::OptionAmbiguous;
+        state->success = false;
+        break;
+
+    case ArgumentFound:     // Is not option-like.
+        // Words up to the first argument may name subcommands, which are
+        // set up the first time they are seen.
+        if (!subcommands.isEmpty() && !state->argumentFound)
+        {
+            Subcommand *subcommand = findSubcommand(state, token);
+            if (subcommand)
+            {
+                Group *group = loadSubcommand(subcommand);
+                if (planDirty)
+                    compilePlan();
+                state->subcommand = subcommand;
+                state->group = group->index;
+                finding.group = state->group;
+                finding.switchValue = 1;
+                valueString = ArgumentRef();
+                break;
+            }
+        }
+        state->argumentFound = true;
+        finding.result = CommandLineParser::ArgumentFound;
+        break;
+
+    default:
+        Q_ASSERT(result.entry >= 0);
+
+        // Is an option, but not found in current group (or only in
+        // subcommands, and none was entered).
+        if (state->group >= 0 ? !plan.isInGroup(result.entry, state->group)
+                              : plan.entries.at(result.entry).scoped)
+        {
+            finding.result = CommandLineParser::GroupMismatch;
+            state->success = false;
+            break;
+        }
+
+        // Lookup successful. Parse!
+        const PlanEntry &entry = plan.entries.at(result.entry);
+        finding.entry = &entry;
+
+        // Option is a negative boolean "switch": If we already have a value
+        // (via --name=value syntax), convert it to inverted boolean,
+        // otherwise return false.
+        if (entry.negative)
+        {
+            if (valueString.isNull())
+                finding.switchValue = 0;
+            else
+                finding.switchValue = !booleanize(valueString);
+        }
+
+        // After clearing the negative switch, this should be one of
+        // OptionSwitch, OptionValueRequired, or OptionValueOptional.
+        switch (entry.mode)
+        {
+        case OptionValueRequired:
+        case OptionValueOptional:
+            // If we already have the value (via --name=value syntax), no need
+            // to search. Otherwise the next token decides, so wait for it.
+            // This token is not needed any more, and might be gone by then.
+            if (valueString.isNull())
+            {
+                finding.tokenString = ArgumentRef();
+                state->pending = finding;
+                state->hasPending = true;
+                return;
+            }
+            break;
+        case OptionSwitch:
+            // Option is a boolean "switch": If we already have a value (via
+            // --name=value syntax), convert it to boolean the way QVariant
+            // would, otherwise return true. Negative switches have their value
+            // converted above already.
+            if (finding.switchValue >= 0)
+                break;
+            if (valueString.isNull())
+                finding.switchValue = 1;
+            else
+                finding.switchValue = valueString.toBool();
+            break;
+        default:
+            finding.result = CommandLineParser::OptionUnknown;
+            break;
+        }
+        break;
+    }
+
+    deliver(state, finding, sink);
+}
+
+template <typename Sink>
+void CommandLineParserPrivate::finishParse(ParseState *state, const Sink &sink)
+{
+    // There is no next token for the pending option to take.
+    if (state->stopped || !state->hasPending)
+        return;
+    state->hasPending = false;
+    setNoValue(&state->pending);
+    deliver(state, state->pending, sink);
+}
+
+template <typename Sink>
+void CommandLineParserPrivate::parseEnvironment(
+        ParseState *state, const Sink &sink, bool afterArguments)
+{
+    bool after = environmentPrecedence ==
+            CommandLineParser::EnvironmentOverArguments;
+    if (plan.environment.isEmpty() || state->stopped ||
+            after != afterArguments)
+        return;
+
+    // One pass over the environment, each name looked up in the hash of
+    // the variables mapped, instead of one getenv() per option.
+    for (char **variable = environ; *variable && !state->stopped; variable++)
+    {
+        const char *equalSign = strchr(*variable, '=');
+        if (!equalSign)
+            continue;
+        ArgumentRef name(*variable, int(equalSign - *variable));
+        ArgumentRef decoded = name;
+        if (!name.isAscii())
+            decoded = ArgumentRef(name.copyTo(&state->scratch.key));
+        int index = plan.environment.indexOf(decoded);
+        if (index < 0)
+            continue;
+
+        const PlanEntry &entry =
+                plan.entries.at(plan.environmentEntries.at(index));
+        if (environmentPrecedence ==
+                CommandLineParser::EnvironmentUnderSettings &&
+                settings && settings->value(entry.name).isValid())
+            continue;
+
+        // As if given as --name=value.
+        Finding finding;
+        finding.tokenString = name;
+        finding.entry = &entry;
+        finding.valueString = ArgumentRef(equalSign + 1);
+        if (entry.mode == OptionSwitch)
+            finding.switchValue = finding.valueString.toBool();
+        deliver(state, finding, sink);
+    }
+}
+
+void CommandLineParserPrivate::setNoValue(Finding *pending)
+{
+    // Notify about missing value if the option requires one, otherwise
+    // assume true.
+    if (pending->entry->mode == OptionValueRequired)
+        pending->result = CommandLineParser::ValueMissing;
+    else
+        pending->switchValue = 1;
+}
+
+template <typename Sink>
+void CommandLineParserPrivate::deliver(ParseState *state, Finding &finding,
+                                       const Sink &sink)
+{
+    // Bound options are written in place, and only reported if their value
+    // is invalid.
+    if (finding.result == CommandLineParser::OptionFound && finding.entry &&
+            finding.entry->binding.convert)
+    {
+        if (assignBoundValue(finding))
+            return;
+        finding.result = CommandLineParser::ValueInvalid;
+        state->success = false;
+    }
+
+#ifdef QCLI_STATISTICS
+    // Callbacks get a name and a value, copied from the token unless it is
+    // a whole QString already.
+    CommandLineParser::Statistics &statistics = state->statistics;
+    statistics.findings[finding.result]++;
+    if (Sink::UsesVariants)
+    {
+        statistics.variantConversions++;
+        bool named = finding.result != CommandLineParser::ArgumentFound &&
+                (!finding.entry ||
+                 finding.result == CommandLineParser::GroupMismatch);
+        if (named && finding.tokenString.needsCopy())
+            statistics.stringAllocations++;
+        if (finding.switchValue < 0 && finding.valueString.needsCopy())
+            statistics.stringAllocations++;
+    }
+#endif
+
+    // Notify observer. If observer stops the operation, quit immediately.
+    bool stop = false;
+    {
+        QCLI_TIME(state->statistics.reportTime);
+        sink.report(finding, &stop);
+    }
+    if (stop)
+        state->stopped = true;
+}
+
+template <typename Source, typename Sink>
+bool CommandLineParserPrivate::parse(const Source &arguments, const Sink &sink)
+{
+    Q_ASSERT(arguments.has(0));
+
+    // Skips the first argument (which is the command name).
+    ParseState state;
+    {
+        QCLI_TIME(state.statistics.parseTime);
+        ActiveParse active(this, &state);
+        beginParse(&state, 1);
+        QCLI_COUNT(state.statistics.parses);
+        if (Source::UsesEnvironment)
+            parseEnvironment(&state, sink, false);
+        for (int i = 1; arguments.has(i) && !state.stopped; i++)
+            step(&state, arguments.at(i), arguments.isError(i), sink);
+        finishParse(&state, sink);
+        if (Source::UsesEnvironment)
+            parseEnvironment(&state, sink, true);
+    }
+    endParse(state);
+    return !state.stopped && state.success;
+}
+
+namespace
+{
+
+// Classifies a slice of the tokens on a pool thread.
+template <typename Source>
+class ClassifyTask : public QRunnable
+{
+public:
+    ClassifyTask(const CommandLineParserPrivate *d, const Source &arguments,
+                 int begin, int end, OptionResult *results,
+                 LookupScratch *scratch, QSemaphore *done) :
+        d(d), arguments(arguments), begin(begin), end(end), results(results),
+        scratch(scratch), done(done) {}
+
+    void run()
+    {
+        for (int i = begin; i < end; i++)
+            results[i - begin] = d->classify(arguments.at(i), scratch);
+        done->release();
+    }
+
+private:
+    const CommandLineParserPrivate *d;
+    const Source &arguments;
+    int begin;
+    int end;
+    OptionResult *results;
+    LookupScratch *scratch;
+    QSemaphore *done;
+};
+
+// Tokens classified before the state machine catches up. Large enough to keep
+// the threads busy for a while, small enough to stay in cache.
+static const int ClassifyBlockSize = 32768;
+
+}   // namespace
+
+template <typename Source>
+void CommandLineParserPrivate::classifyParallel(
+        ParseState *state, const Source &arguments, int begin, int end,
+        OptionResult *results, int threads)
+{
+    QCLI_TIME(state->statistics.classifyTime);
+
+    // The calling thread takes the first slice itself. A slice the pool has
+    // no thread for is classified here too, rather than waited for.
+    int sliceSize = (end - begin + threads - 1) / threads;
+    int started = 0;
+    QSemaphore done;
+    QVector<LookupScratch> scratches(threads - 1);
+    LookupScratch *scratch = scratches.data();
+    for (int first = begin + sliceSize; first < end; first += sliceSize)
+    {
+        int last = qMin(first + sliceSize, end);
+        ClassifyTask<Source> *task = new ClassifyTask<Source>(
+                    this, arguments, first, last, results + (first - begin),
+                    scratch++, &done);
+        if (threadPool->tryStart(task))
+        {
+            started++;
+        }
+        else
+        {
+            task->run();
+            delete task;
+            done.acquire();
+        }
+    }
+    ClassifyTask<Source>(this, arguments, begin, qMin(begin + sliceSize, end),
+                         results, &state->scratch, &done).run();
+    done.acquire(started + 1);
+
+    for (int i = 0; i < scratches.size(); i++)
+    {
+        QCLI_COUNT_ADD(state->scratch.dictionaryProbes,
+                       scratches.at(i).dictionaryProbes);
+        QCLI_COUNT_ADD(state->scratch.groupProbes,
+                       scratches.at(i).groupProbes);
+    }
+}
+
+template <typename Sink>
+bool CommandLineParserPrivate::parseCommand(const QString &command,
+                                           const Sink &sink)
+{
+    CommandStringSource source(command);
+    if (source.isValid())
+        return parseArguments(source, sink);
+
+    // A shell would not run a command it cannot split, so nothing of it is
+    // reported but the error.
+    ParseState state;
+    {
+        ActiveParse active(this, &state);
+        beginParse(&state, source.size());
+        QCLI_COUNT(state.statistics.parses);
+        Finding finding;
+        finding.result = CommandLineParser::QuotingError;
+        finding.token = state.token;
+        finding.tokenString = source.errorToken();
+        state.success = false;
+        deliver(&state, finding, sink);
+    }
+    endParse(state);
+    return false;
+}
+
+template <typename Source, typename Sink>
+bool CommandLineParserPrivate::parseParallel(
+        const Source &arguments, const Sink &sink, int threads)
+{
+    Q_ASSERT(arguments.has(0));
+    Q_ASSERT(threadPool);
+
+    ParseState state;
+    {
+        QCLI_TIME(state.statistics.parseTime);
+        ActiveParse active(this, &state);
+        beginParse(&state, 1);
+        QCLI_COUNT(state.statistics.parses);
+        if (Source::UsesEnvironment)
+            parseEnvironment(&state, sink, false);
+        int count = arguments.size();
+        QVector<OptionResult> results(qMin(count, ClassifyBlockSize));
+        for (int begin = 1; begin < count && !state.stopped;
+             begin += ClassifyBlockSize)
+        {
+            int end = qMin(begin + ClassifyBlockSize, count);
+            classifyParallel(&state, arguments, begin, end, results.data(),
+                             threads);
+            for (int i = begin; i < end && !state.stopped; i++)
+                step(&state, arguments.at(i), false, results.at(i - begin),
+                     sink);
+        }
+        finishParse(&state, sink);
+        if (Source::UsesEnvironment)
+            parseEnvironment(&state, sink, true);
+    }
+    endParse(state);
+    return !state.stopped && state.success;
+}
+
+int CommandLineParserPrivate::threadCount() const
+{
+    if (parsingThreadCount > 0)
+        return parsingThreadCount;
+    return QThread::idealThreadCount();
+}
+
+bool CommandLineParserPrivate::assignBoundValue(const Finding &finding)
+{
+    const ValueBinding &binding = finding.entry->binding;
+    if (finding.switchValue >= 0)
+    {
+        // An optional value that was not given only sets bool targets (to
+        // true, like an unbound option reports it); others keep their value.
+        if (finding.entry->mode == OptionValueOptional &&
+                binding.convert != &Internal::ValueConverter<bool>::convert)
+            return true;
+        return binding.convert(finding.switchValue ? "true" : "false", binding);
+    }
+    return binding.convert(finding.valueString, binding);
+}
+
+bool CommandLineParserPrivate::booleanize(const ArgumentRef &str)
+{
+    // Strip surrounding whitespace.
+    int begin = 0;
+    int end = str.size();
+    while (begin < end && QChar(str.at(begin)).isSpace())
+        begin++;
+    while (end > begin && QChar(str.at(end - 1)).isSpace())
+        end--;
+    ArgumentRef stripped = str.mid(begin).left(end - begin);
+
+    // Try integer parsing. Any non-zero digit makes a non-zero integer (even
+    // one that would overflow, which is judged by length below anyway).
+    int i = 0;
+    if (i < stripped.size() && (stripped.at(i) == '+' || stripped.at(i) == '-'))
+        i++;
+    if (i < stripped.size())
+    {
+        bool isInteger = true;
+        bool isZero = true;
+        for (; isInteger && i < stripped.size(); i++)
+        {
+            ushort c = stripped.at(i);
+            isInteger = (c >= '0' && c <= '9');
+            if (c != '0')
+                isZero = false;
+        }
+        if (isInteger)
+            return !isZero;
+    }
+
+    // Try boolean parsing.
+    if (equalsIgnoreCase(stripped, "false"))
+        return false;
+
+    // Judge by string length.
+    return stripped.size();
+}
+
+bool CommandLineParserPrivate::equalsIgnoreCase(
+        const ArgumentRef &str, const char *latin1)
+{
+    int i = 0;
+    for (; latin1[i]; i++)
+    {
+        if (i >= str.size())
+            return false;
+        if (QChar(str.at(i)).toLower() != QChar::fromLatin1(latin1[i]))
+            return false;
+    }
+    return i == str.size();
 }
 
 
@@ -482,6 +1654,7 @@ void CommandLineParser::beginOptionGroup(const QString &name)
 
     d->currentGroup = new Group(name);
     d->groups.insert(name, d->currentGroup);
+    d->planDirty = true;
 }
 
 void CommandLineParser::endOptionGroup()
@@ -490,28 +1663,48 @@ void CommandLineParser::endOptionGroup()
     d->currentGroup = 0;
 }
 
+void CommandLineParser::addSubcommand(
+        const QString &path, SubcommandFactory factory)
+{
+    Q_D(CommandLineParser);
+    if (d->subcommands.contains(path))
+    {
+        QTextStream err(d->errDevice);
+        err << "Subcommand " << path << " is already registered!" << endl;
+        return;
+    }
+    d->subcommands.insert(path, new Subcommand(path, factory));
+}
+
+void CommandLineParser::loadSubcommand(const QString &path)
+{
+    Q_D(CommandLineParser);
+    Subcommand *subcommand = d->subcommands.value(path);
+    if (subcommand)
+        d->loadSubcommand(subcommand);
+}
+
 void CommandLineParser::addOption(
         const QString &name, const QChar &alias, OptionFlags flags)
 {
     Q_D(CommandLineParser);
-    Option *option = new Option(name, alias, flags, this);
-    d->insertOption(QString("%1%2").arg(OptionNamePrefix, name), option);
-    if (d->currentGroup)
-        d->currentGroup->addOption(option);
+    Option option(name, flags);
+    option.index = d->registerOptionName(name);
+    int slot = d->addOptionSlot(option);
+    d->insertOption(QString("%1%2").arg(OptionNamePrefix, name), slot);
 
     if (!alias.isNull())
     {
         QString key = QString("%1%2").arg(OptionAliasPrefix, alias);
-        d->insertOption(key, option);
+        d->insertOption(key, slot);
     }
 
     if (flags & OptionNegativeSwitch)
     {
-        Option *negativeOption = new Option(name, OptionSwitch, this);
+        Option negativeOption(name, OptionSwitch, true);
+        negativeOption.index = option.index;
         d->insertOption(QString("%1no-%2").arg(OptionNamePrefix, name),
-                        negativeOption);
-        if (d->currentGroup)
-            d->currentGroup->addOption(negativeOption);
+                        d->addOptionSlot(negativeOption));
     }
 }
 
@@ -520,20 +1713,73 @@ void CommandLineParser::addOption(const QString &name, OptionFlags flags)
     addOption(name, QChar(), flags);
 }
 
+void CommandLineParser::addBoundOption(
+        const QString &name, const QChar &alias, OptionFlags flags,
+        const ValueBinding &binding)
+{
+    Q_D(CommandLineParser);
+    addOption(name, alias, flags);
+
+    // Both the positive and negative forms write into the same variable.
+    QString key = QString("%1%2").arg(OptionNamePrefix, name);
+    d->optionSlots[d->options.value(key)].binding = binding;
+    if (flags & OptionNegativeSwitch)
+    {
+        key = QString("%1no-%2").arg(OptionNamePrefix, name);
+        d->optionSlots[d->options.value(key)].binding = binding;
+    }
+}
+
+void CommandLineParser::freeze()
+{
+    Q_D(CommandLineParser);
+
+    // Parses would otherwise load subcommands as they see them, changing the
+    // parser. Loading one may register more.
+    bool loaded;
+    do
+    {
+        loaded = false;
+        QList<Subcommand *> subcommands = d->subcommands.values();
+        foreach (Subcommand *subcommand, subcommands)
+        {
+            if (subcommand->group)
+                continue;
+            d->loadSubcommand(subcommand);
+            loaded = true;
+        }
+    } while (loaded);
+
+    if (d->planDirty)
+        d->compilePlan();
+}
+
+void CommandLineParser::addOptions(
+        const OptionDescription *options, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const OptionDescription &option = options[i];
+        QChar alias = option.alias ? QChar::fromLatin1(option.alias) : QChar();
+        addOption(QString::fromLatin1(option.name), alias,
+                  OptionFlags(option.flags));
+    }
+}
+
 bool CommandLineParser::parse(
         const QList<QString> &arguments, QObject *obj, const char *callback)
 {
     Q_D(CommandLineParser);
-    return d->parse(arguments, CallbackInvoker(this, obj, callback));
+    return d->parseArguments(StringListSource(arguments),
+                    CallbackInvoker(this, obj, callback));
 }
 
 bool CommandLineParser::parse(
         int argc, char *argv[], QObject *obj, const char *callback)
 {
-    QStringList arguments;
-    for (int i = 0; i < argc; i++)
-        arguments.append(QString::fromLocal8Bit(argv[i]));
-    return parse(arguments, obj, callback);
+    Q_D(CommandLineParser);
+    return d->parseArguments(ArgvSource(argc, argv),
+                    CallbackInvoker(this, obj, callback));
 }
 
 bool CommandLineParser::parse(QObject *obj, const char *callback)
@@ -544,17 +1790,16 @@ bool CommandLineParser::parse(QObject *obj, const char *callback)
 bool CommandLineParser::parse(
         const QList<QString> &arguments, ParsingCallback callback)
 {
-    // TODO: If callback is null, use default.
     Q_D(CommandLineParser);
-    return d->parse(arguments, CallbackInvoker(this, callback));
+    return d->parseArguments(StringListSource(arguments),
+                    CallbackInvoker(this, callback));
 }
 
 bool CommandLineParser::parse(int argc, char *argv[], ParsingCallback callback)
 {
-    QStringList arguments;
-    for (int i = 0; i < argc; i++)
-        arguments.append(QString::fromLocal8Bit(argv[i]));
-    return parse(arguments, callback);
+    Q_D(CommandLineParser);
+    return d->parseArguments(ArgvSource(argc, argv),
+                             CallbackInvoker(this, callback));
 }
 
 bool CommandLineParser::parse(ParsingCallback callback)
@@ -562,6 +1807,392 @@ bool CommandLineParser::parse(ParsingCallback callback)
     return parse(qApp->arguments(), callback);
 }
 
+bool CommandLineParser::parseWithThunk(
+        const QList<QString> &arguments, ParsingThunk thunk, void *context)
+{
+    Q_D(CommandLineParser);
+    return d->parseArguments(StringListSource(arguments),
+                    CallbackInvoker(this, thunk, context));
+}
+
+bool CommandLineParser::parseWithThunk(
+        int argc, char *argv[], ParsingThunk thunk, void *context)
+{
+    Q_D(CommandLineParser);
+    return d->parseArguments(ArgvSource(argc, argv),
+                    CallbackInvoker(this, thunk, context));
+}
+
+ParseResult CommandLineParser::parseAll(const QList<QString> &arguments)
+{
+    Q_D(CommandLineParser);
+    if (d->planDirty)
+        d->compilePlan();
+    ParseResult result;
+    d->parseArguments(StringListSource(arguments),
+             ParseResultBuilder(&result, d->plan, arguments.size()));
+    return result;
+}
+
+ParseResult CommandLineParser::parseAll(int argc, char *argv[])
+{
+    Q_D(CommandLineParser);
+    if (d->planDirty)
+        d->compilePlan();
+    ParseResult result;
+    d->parseArguments(ArgvSource(argc, argv),
+             ParseResultBuilder(&result, d->plan, argc));
+    return result;
+}
+
+ParseResult CommandLineParser::parseAll()
+{
+    return parseAll(qApp->arguments());
+}
+
+bool CommandLineParser::parseAll(
+        const QList<QString> &arguments, ParseResult *result)
+{
+    Q_D(CommandLineParser);
+    if (d->planDirty)
+        d->compilePlan();
+    ParseResultBuilder::reset(result);
+    return d->parseArguments(StringListSource(arguments),
+                    ParseResultBuilder(result, d->plan, arguments.size()));
+}
+
+bool CommandLineParser::parseAll(int argc, char *argv[], ParseResult *result)
+{
+    Q_D(CommandLineParser);
+    if (d->planDirty)
+        d->compilePlan();
+    ParseResultBuilder::reset(result);
+    return d->parseArguments(ArgvSource(argc, argv),
+                    ParseResultBuilder(result, d->plan, argc));
+}
+
+bool CommandLineParser::parseCommand(
+        const QString &command, ParsingCallback callback)
+{
+    Q_D(CommandLineParser);
+    return d->parseCommand(command, CallbackInvoker(this, callback));
+}
+
+bool CommandLineParser::parseCommand(
+        const QString &command, QObject *obj, const char *callback)
+{
+    Q_D(CommandLineParser);
+    return d->parseCommand(command, CallbackInvoker(this, obj, callback));
+}
+
+ParseResult CommandLineParser::parseAllCommand(const QString &command)
+{
+    Q_D(CommandLineParser);
+    if (d->planDirty)
+        d->compilePlan();
+    ParseResult result;
+    d->parseCommand(command, ParseResultBuilder(&result, d->plan, 0));
+    return result;
+}
+
+bool CommandLineParser::splitCommand(
+        const QString &command, QStringList *arguments)
+{
+    CommandStringSource source(command);
+    arguments->clear();
+    if (!source.isValid())
+        return false;
+    for (int i = 0; i < source.size(); i++)
+        arguments->append(source.at(i).toString());
+    return true;
+}
+
+QStringList CommandLineParser::complete(const QList<QString> &words)
+{
+    Q_D(CommandLineParser);
+    if (d->planDirty)
+        d->compilePlan();
+    return d->complete(words);
+}
+
+bool CommandLineParser::handleCompletion(int argc, char *argv[])
+{
+    if (argc < 2)
+        return false;
+    QString mode = QString::fromLocal8Bit(argv[1]);
+    if (mode == QLatin1String("--completion-script"))
+    {
+        QString shell;
+        if (argc > 2)
+            shell = QString::fromLocal8Bit(argv[2]);
+        QString program = QFileInfo(QString::fromLocal8Bit(argv[0])).fileName();
+        QTextStream out(stdOut());
+        out << completionScript(program, shell == QLatin1String("zsh") ?
+                                             ZshCompletion : BashCompletion);
+        return true;
+    }
+    if (mode != QLatin1String("--complete"))
+        return false;
+
+    QStringList words;
+    for (int i = 2; i < argc; i++)
+        words.append(QString::fromLocal8Bit(argv[i]));
+    QTextStream out(stdOut());
+    foreach (const QString &candidate, complete(words))
+        out << candidate << '\n';
+    return true;
+}
+
+QString CommandLineParser::completionScript(const QString &program,
+                                            CompletionShell shell)
+{
+    // Shell function names only take some characters.
+    QString function = "_qcli_complete_";
+    for (int i = 0; i < program.size(); i++)
+    {
+        QChar c = program.at(i);
+        function += c.isLetterOrNumber() ? c : QChar('_');
+    }
+
+    // Both pass the words up to the cursor to the program, and fall back to
+    // completing file names if it has nothing to offer.
+    QString script;
+    if (shell == ZshCompletion)
+    {
+        script = "%1() {\n"
+                 "    local -a candidates\n"
+                 "    candidates=(\"${(@f)$(\"${words[1]}\" --complete "
+                 "\"${(@)words[1,CURRENT]}\" 2>/dev/null)}\")\n"
+                 "    if [[ -n \"${candidates[1]}\" ]]; then\n"
+                 "        compadd -a candidates\n"
+                 "    else\n"
+                 "        _files\n"
+                 "    fi\n"
+                 "}\n"
+                 "compdef %1 %2\n";
+    }
+    else
+    {
+        script = "%1() {\n"
+                 "    local IFS=$'\\n'\n"
+                 "    COMPREPLY=($(\"${COMP_WORDS[0]}\" --complete "
+                 "\"${COMP_WORDS[@]:0:COMP_CWORD+1}\" 2>/dev/null))\n"
+                 "}\n"
+                 "complete -o default -F %1 %2\n";
+    }
+    return script.arg(function, program);
+}
+
+int CommandLineParser::optionIndex(const QString &name) const
+{
+    return d_ptr->optionIndexes.value(name, -1);
+}
+
+int CommandLineParser::parsingThreadCount() const
+{
+    return d_ptr->parsingThreadCount;
+}
+
+void CommandLineParser::setParsingThreadCount(int count)
+{
+    Q_D(CommandLineParser);
+    d->parsingThreadCount = qMax(count, 0);
+
+    // The pool is set up here, not while parsing, so parses running at the
+    // same time can share it. The calling thread takes a slice itself.
+    int threads = d->threadCount();
+    if (threads > 1)
+    {
+        if (!d->threadPool)
+            d->threadPool = new QThreadPool();
+        d->threadPool->setMaxThreadCount(threads - 1);
+    }
+}
+
+int CommandLineParser::parallelThreshold() const
+{
+    return d_ptr->parallelThreshold;
+}
+
+void CommandLineParser::setParallelThreshold(int tokens)
+{
+    Q_D(CommandLineParser);
+    d->parallelThreshold = tokens;
+}
+
+CommandLineParser::Statistics::Statistics() :
+    parses(0), tokens(0), dictionaryProbes(0), groupProbes(0),
+    lookaheadChecks(0), variantConversions(0), stringAllocations(0),
+    compileTime(0), classifyTime(0), parseTime(0), reportTime(0)
+{
+    for (int i = 0; i < ResultCount; i++)
+        findings[i] = 0;
+}
+
+bool CommandLineParser::statisticsEnabled()
+{
+#ifdef QCLI_STATISTICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+CommandLineParser::Statistics CommandLineParser::statistics() const
+{
+#ifdef QCLI_STATISTICS
+    QMutexLocker locker(&d_ptr->statisticsMutex);
+#endif
+    return d_ptr->statistics;
+}
+
+void CommandLineParser::resetStatistics()
+{
+    Q_D(CommandLineParser);
+#ifdef QCLI_STATISTICS
+    QMutexLocker locker(&d->statisticsMutex);
+#endif
+    d->statistics = Statistics();
+}
+
+bool CommandLineParser::abbreviationsEnabled() const
+{
+    return d_ptr->abbreviationsEnabled;
+}
+
+void CommandLineParser::setAbbreviationsEnabled(bool enabled)
+{
+    Q_D(CommandLineParser);
+    d->abbreviationsEnabled = enabled;
+}
+
+void CommandLineParser::beginFeed(ParsingCallback callback, bool keepResult)
+{
+    Q_D(CommandLineParser);
+    delete d->feed;
+    d->feed = new FeedState(CallbackInvoker(this, callback), keepResult);
+    d->beginParse(&d->feed->state, 0);
+}
+
+void CommandLineParser::beginFeed(
+        QObject *obj, const char *callback, bool keepResult)
+{
+    Q_D(CommandLineParser);
+    delete d->feed;
+    d->feed = new FeedState(CallbackInvoker(this, obj, callback), keepResult);
+    d->beginParse(&d->feed->state, 0);
+}
+
+bool CommandLineParser::feed(const QString &token)
+{
+    Q_D(CommandLineParser);
+    if (!d->feed || d->feed->finished)
+        return false;
+    ActiveParse active(d, &d->feed->state);
+    d->step(&d->feed->state, ArgumentRef(token), false,
+            FeedSink(d->feed, d->plan));
+    return !d->feed->state.stopped;
+}
+
+bool CommandLineParser::feed(const char *token)
+{
+    Q_D(CommandLineParser);
+    if (!d->feed || d->feed->finished)
+        return false;
+    ActiveParse active(d, &d->feed->state);
+    d->step(&d->feed->state, ArgumentRef(token), false,
+            FeedSink(d->feed, d->plan));
+    return !d->feed->state.stopped;
+}
+
+bool CommandLineParser::finish()
+{
+    Q_D(CommandLineParser);
+    if (!d->feed || d->feed->finished)
+        return false;
+    {
+        ActiveParse active(d, &d->feed->state);
+        d->finishParse(&d->feed->state, FeedSink(d->feed, d->plan));
+    }
+    d->endParse(d->feed->state);
+    d->feed->finished = true;
+    return !d->feed->state.stopped && d->feed->state.success;
+}
+
+ParseResult CommandLineParser::feedResult() const
+{
+    if (!d_ptr->feed)
+        return ParseResult();
+    return d_ptr->feed->result;
+}
+
+bool CommandLineParser::responseFilesEnabled() const
+{
+    return d_ptr->responseFilesEnabled;
+}
+
+void CommandLineParser::setResponseFilesEnabled(bool enabled)
+{
+    Q_D(CommandLineParser);
+    d->responseFilesEnabled = enabled;
+}
+
+CommandLineParser::ResponseFileFormat
+CommandLineParser::responseFileFormat() const
+{
+    return ResponseFileFormat(d_ptr->responseFileFormat);
+}
+
+void CommandLineParser::setResponseFileFormat(ResponseFileFormat format)
+{
+    Q_D(CommandLineParser);
+    d->responseFileFormat = format;
+}
+
+qint64 CommandLineParser::responseFileSizeLimit() const
+{
+    return d_ptr->responseFileSizeLimit;
+}
+
+void CommandLineParser::setResponseFileSizeLimit(qint64 bytes)
+{
+    Q_D(CommandLineParser);
+    d->responseFileSizeLimit = bytes;
+}
+
+QString CommandLineParser::environmentPrefix() const
+{
+    return d_ptr->environmentPrefix;
+}
+
+void CommandLineParser::setEnvironmentPrefix(const QString &prefix)
+{
+    Q_D(CommandLineParser);
+    d->environmentPrefix = prefix;
+    d->planDirty = true;
+}
+
+void CommandLineParser::setEnvironmentVariable(
+        const QString &option, const QString &variable)
+{
+    Q_D(CommandLineParser);
+    d->environmentVariables.insert(option, variable);
+    d->planDirty = true;
+}
+
+CommandLineParser::EnvironmentPrecedence
+CommandLineParser::environmentPrecedence() const
+{
+    return EnvironmentPrecedence(d_ptr->environmentPrecedence);
+}
+
+void CommandLineParser::setEnvironmentPrecedence(
+        EnvironmentPrecedence precedence)
+{
+    Q_D(CommandLineParser);
+    d->environmentPrecedence = precedence;
+}
+
 Settings *CommandLineParser::settings() const
 {
     return d_ptr->settings;
@@ -575,6 +2206,11 @@ void CommandLineParser::setSettings(Settings *s)
 
 QString CommandLineParser::currentGroupName() const
 {
+    // Callbacks get the group of the parse calling them.
+    const ParseState *state = ActiveParse::find(d_ptr);
+    int group = state ? state->group : d_ptr->lastGroup.fetchAndAddRelaxed(0);
+    if (group >= 0)
+        return d_ptr->plan.groupNames.at(group);
     if (!d_ptr->currentGroup)
         return QString();
     return d_ptr->currentGroup->name;
@@ -615,19 +2251,35 @@ static void simpleParsingCallback(
     case CommandLineParser::OptionUnknown:
         err << "Unknown command line option " << name << ", try --help!";
         break;
+    case CommandLineParser::OptionAmbiguous:
+        err << "Ambiguous command line option " << name << ", try --help!";
+        break;
     case CommandLineParser::ValueMissing:
         err << "Missing value for command line option " << name <<
                ", try --help!";
         break;
+    case CommandLineParser::ResponseFileError:
+        err << "Cannot read response file " << name << "!";
+        break;
+    case CommandLineParser::QuotingError:
+        err << "Unterminated quote or escape in command at " << name << "!";
+        break;
+    case CommandLineParser::ValueInvalid:
+        err << "Invalid value " << value.toString() <<
+               " for command line option " << name << ", try --help!";
+        break;
     case CommandLineParser::GroupMismatch:
         err << "Invalid option " << name << " for group " <<
                parser->currentGroupName() << ", try --help!";
         break;
     case CommandLineParser::ArgumentFound:
-        parser->settings()->addArgument(value.toString());
+        if (parser->settings())
+            parser->settings()->addArgument(value.toString());
         break;
     case CommandLineParser::OptionFound:
-        parser->settings()->setValue(name, value);
+        if (parser->settings())
+            parser->settings()->setValue(name, value);
+        break;
     }
 }
 
@@ -3,13 +3,25 @@
 
 #include <QObject>
 #include <QMetaType>
+#include <QVariant>
 #include "qcli_global.h"
 #include "qclioption.h"
+#include "qclivaluebinding.h"
 
 namespace QCli
 {
 
+namespace Internal
+{
+template <typename T>
+struct EnableIfCallable
+{
+    typedef bool Type;
+};
+}   // namespace Internal
+
 class Settings;
+class ParseResult;
 class CommandLineParserPrivate;
 
 class QCLIISHARED_EXPORT CommandLineParser : public QObject
@@ -27,12 +39,71 @@ public:
         GroupMismatch,
         ValueMissing,
         OptionUnknown,
+        OptionAmbiguous,
+        ValueInvalid,
+        ResponseFileError,
+        QuotingError,
     };
     Q_ENUMS(ParsingResult)
 
+    enum CompletionShell
+    {
+        BashCompletion,
+        ZshCompletion,
+    };
+
+    // Which source wins when an option is given in the environment, in the
+    // settings (see setSettings()), and on the command line.
+    enum EnvironmentPrecedence
+    {
+        EnvironmentOverSettings,    // Command line, environment, settings.
+        EnvironmentOverArguments,   // Environment, command line, settings.
+        EnvironmentUnderSettings,   // Command line, settings, environment.
+    };
+
+    enum ResponseFileFormat
+    {
+        ResponseFileWhitespace,     // Separated by whitespace.
+        ResponseFileLines,          // One argument per line.
+        ResponseFileNul,            // Separated by NUL, like xargs -0.
+    };
+
+    // Counters accumulated over every parse since the parser was created or
+    // the statistics were reset. They are only kept if the library is built
+    // with QCLI_STATISTICS defined (CONFIG+=qcli_statistics), and stay zero
+    // otherwise.
+    struct QCLIISHARED_EXPORT Statistics
+    {
+        Statistics();
+
+        enum { ResultCount = QuotingError + 1 };
+
+        quint64 parses;
+        quint64 tokens;
+        quint64 dictionaryProbes;       // Lookups of option names.
+        quint64 groupProbes;            // Lookups of other words.
+        quint64 lookaheadChecks;        // Tokens offered to a pending option.
+        quint64 findings[ResultCount];  // Reported, by ParsingResult.
+        quint64 variantConversions;     // Values passed to callbacks.
+        quint64 stringAllocations;      // Names and values copied from tokens.
+
+        // Wall time of each phase, in nanoseconds. Parsing includes the
+        // others, except for compiling.
+        qint64 compileTime;
+        qint64 classifyTime;            // Of parallel parses only.
+        qint64 parseTime;
+        qint64 reportTime;
+    };
+
     typedef void (*ParsingCallback)(
             CommandLineParser *parser, CommandLineParser::ParsingResult result,
             const QString &name, QVariant value, bool *stop);
+    typedef void (*ParsingThunk)(
+            void *context, CommandLineParser *parser,
+            CommandLineParser::ParsingResult result,
+            const QString &name, QVariant value, bool *stop);
+    typedef void (*SubcommandFactory)(CommandLineParser *parser,
+                                      const QString &path);
 
     explicit CommandLineParser(QObject *parent = 0);
     ~CommandLineParser();
@@ -40,10 +111,71 @@ public:
     void beginOptionGroup(const QString &name);
     void endOptionGroup();
 
+    // Subcommands, as in "tool remote add", are named by their path: the
+    // names from the top level down, separated by spaces. The factory of a
+    // subcommand registers its options (and any subcommands below it), into
+    // an option group named by the path, only when the subcommand is first
+    // seen while parsing; registering a subcommand costs nothing else. The
+    // options of a subcommand are only valid in it, and in the subcommands
+    // below it.
+    // Subcommand names are only recognized before the first argument.
+    // Loading a subcommand changes the parser, so freeze() loads them all.
+    void addSubcommand(const QString &path, SubcommandFactory factory);
+    void loadSubcommand(const QString &path);
+
     void addOption(const QString &name, const QChar &alias,
                    OptionFlags flags = OptionValueNone);
     void addOption(const QString &name, OptionFlags flags = OptionValueNone);
 
+    // Binds the option to a variable of type int, qint64, double, bool,
+    // QString or QStringList. Values are converted and written there while
+    // parsing, and are not reported to callbacks; a value that cannot be
+    // converted is reported as ValueInvalid instead. Switches bound to bool
+    // get their boolean value.
+    template <typename T>
+    inline void addOption(
+            const QString &name, const QChar &alias, T *target,
+            OptionFlags flags =
+                OptionFlags(Internal::ValueConverter<T>::DefaultFlags))
+    {
+        ValueBinding binding;
+        binding.convert = &Internal::ValueConverter<T>::convert;
+        binding.target = target;
+        addBoundOption(name, alias, flags, binding);
+    }
+
+    // Binds the option to an enum variable. Values can be given by key (as
+    // listed by enumerator), or as integers.
+    template <typename Enum>
+    inline void addOption(
+            const QString &name, const QChar &alias, Enum *target,
+            const QMetaEnum &enumerator,
+            OptionFlags flags = OptionValueRequired)
+    {
+        ValueBinding binding;
+        binding.convert = &Internal::EnumConverter<Enum>::convert;
+        binding.target = target;
+        binding.enumerator = enumerator;
+        addBoundOption(name, alias, flags, binding);
+    }
+
+    void addOptions(const OptionDescription *options, int count);
+    template <int N>
+    inline void addOptions(const OptionDescription (&options)[N])
+    {
+        addOptions(options, N);
+    }
+
+    // Loads every registered subcommand (including those registered while
+    // loading), and compiles the registered options for parsing. Once
+    // frozen, a parser can be parsed with from any number of threads at
+    // once, without locking: each parse keeps its state to itself, and only
+    // reads the options. The callbacks and bound variables are the caller's
+    // to synchronize, and options and settings must not be changed while
+    // parses are running. Incremental parsing (beginFeed) is one parse per
+    // parser.
+    void freeze();
+
     bool parse(const QList<QString> &arguments,
                QObject *obj, const char *callback);
     bool parse(int argc, char *argv[], QObject *obj, const char *callback);
@@ -53,6 +185,169 @@ public:
     bool parse(int argc, char *argv[], ParsingCallback callback = 0);
     bool parse(ParsingCallback callback = 0);
 
+    // Calls obj->*callback directly, without going through the meta-object
+    // system.
+    template <typename T>
+    inline bool parse(const QList<QString> &arguments, T *obj,
+                      void (T::*callback)(CommandLineParser *, ParsingResult,
+                                          const QString &, QVariant, bool *))
+    {
+        MemberThunk<T> thunk(obj, callback);
+        return parseWithThunk(arguments, &MemberThunk<T>::invoke, &thunk);
+    }
+    template <typename T>
+    inline bool parse(int argc, char *argv[], T *obj,
+                      void (T::*callback)(CommandLineParser *, ParsingResult,
+                                          const QString &, QVariant, bool *))
+    {
+        MemberThunk<T> thunk(obj, callback);
+        return parseWithThunk(argc, argv, &MemberThunk<T>::invoke, &thunk);
+    }
+
+#ifdef Q_COMPILER_DECLTYPE
+    // Takes anything callable like a ParsingCallback, e.g. a lambda or a
+    // functor. The call is resolved (and usually inlined) at compile time.
+    template <typename Functor>
+    inline bool parse(
+            const QList<QString> &arguments, Functor functor,
+            typename Internal::EnableIfCallable<decltype(
+                (*static_cast<Functor *>(0))(
+                    static_cast<CommandLineParser *>(0), OptionFound,
+                    QString(), QVariant(), static_cast<bool *>(0)))>::Type
+                        * = 0)
+    {
+        return parseWithThunk(arguments, &FunctorThunk<Functor>::invoke,
+                              &functor);
+    }
+    template <typename Functor>
+    inline bool parse(
+            int argc, char *argv[], Functor functor,
+            typename Internal::EnableIfCallable<decltype(
+                (*static_cast<Functor *>(0))(
+                    static_cast<CommandLineParser *>(0), OptionFound,
+                    QString(), QVariant(), static_cast<bool *>(0)))>::Type
+                        * = 0)
+    {
+        return parseWithThunk(argc, argv, &FunctorThunk<Functor>::invoke,
+                              &functor);
+    }
+#endif
+
+    // Incremental parsing, for arguments that arrive one at a time (e.g.
+    // read from a pipe). Arguments are fed without the command name, and
+    // reported as soon as they are complete: only the option waiting for a
+    // value and the selected group are kept in between, so memory use does
+    // not grow with the input. If keepResult is true, everything reported is
+    // also collected into feedResult(). feed() returns false once the
+    // callback stops parsing; finish() returns what parse() would.
+    void beginFeed(ParsingCallback callback = 0, bool keepResult = false);
+    void beginFeed(QObject *obj, const char *callback,
+                   bool keepResult = false);
+    bool feed(const QString &token);
+    bool feed(const char *token);
+    bool finish();
+    ParseResult feedResult() const;
+
+    // Parses without callbacks, collecting everything found into one
+    // result. Include qcliparseresult.h to use these.
+    ParseResult parseAll(const QList<QString> &arguments);
+    ParseResult parseAll(int argc, char *argv[]);
+    ParseResult parseAll();
+
+    // Same, into a result kept from an earlier parse, replacing what it
+    // held. Its memory is reused, so a dispatcher parsing over and over into
+    // the same result stops allocating once the result has grown to fit.
+    // Returns whether the parse succeeded.
+    bool parseAll(const QList<QString> &arguments, ParseResult *result);
+    bool parseAll(int argc, char *argv[], ParseResult *result);
+
+    // Parses a command given as one string (e.g. received by a daemon),
+    // split into arguments the way a POSIX shell would: words are separated
+    // by blanks, and can be quoted with '' or "" or escaped with \. Nothing is
+    // expanded. The first word is the command name, as in argv. Words are
+    // only copied if they have to be unescaped. A command that cannot be
+    // split (because a quote is not closed, or it ends with \) is reported
+    // as a single QuotingError, and not parsed at all; splitCommand() returns
+    // false for it.
+    bool parseCommand(const QString &command, ParsingCallback callback = 0);
+    bool parseCommand(const QString &command,
+                      QObject *obj, const char *callback);
+    ParseResult parseAllCommand(const QString &command);
+    static bool splitCommand(const QString &command, QStringList *arguments);
+
+    // Shell completion. complete() takes the words of a command line up to
+    // the word being completed (which is last, and may be empty), and
+    // returns what that word can be: options valid in the group or
+    // subcommand selected (with their aliases and --no- forms), group
+    // names and subcommand names. Values and arguments are left to the
+    // shell. Only the subcommands named in the words are loaded.
+    //
+    // handleCompletion() serves the shell glue: "--complete <words>" writes
+    // the candidates to stdOut(), one per line, and "--completion-script
+    // bash|zsh" writes the glue itself (for e.g. "source <(tool
+    // --completion-script bash)"). It returns whether it handled either.
+    // Call it right after registering the options, before anything else is
+    // set up (not even a QCoreApplication is needed), and exit if it
+    // returns true.
+    QStringList complete(const QList<QString> &words);
+    bool handleCompletion(int argc, char *argv[]);
+    static QString completionScript(const QString &program,
+                                    CompletionShell shell);
+
+    // Index of the option in the order options were registered, or -1. This
+    // is the index ParseResult uses.
+    int optionIndex(const QString &name) const;
+
+    // Replaces each @path argument by the arguments in the file at path,
+    // which may refer to further response files. Files are memory-mapped and
+    // read as parsing goes. A file that cannot be read is reported as
+    // ResponseFileError, as is one that would take the total size of response
+    // files past the limit (in bytes, 0 for none). Disabled by default.
+    bool responseFilesEnabled() const;
+    void setResponseFilesEnabled(bool enabled);
+    ResponseFileFormat responseFileFormat() const;
+    void setResponseFileFormat(ResponseFileFormat format);
+    qint64 responseFileSizeLimit() const;
+    void setResponseFileSizeLimit(qint64 bytes);
+
+    // Options can also be set by environment variables, all read in one pass
+    // over the environment when argv or an argument list is parsed (command
+    // strings and feeds do not read it). With a prefix like "MYTOOL_", the
+    // variable of --dry-run is MYTOOL_DRY_RUN: the option name in upper case
+    // with dashes as underscores. setEnvironmentVariable() maps an option to
+    // another variable, or to none if the variable is empty, and works
+    // without a prefix, too. A variable is reported like --name=value, with
+    // a token index of -1. Options only valid in subcommands are not read.
+    //
+    // Variables are reported before the arguments, so arguments override
+    // them in the settings and bound variables, unless the precedence is
+    // EnvironmentOverArguments; then they are reported after the arguments.
+    // With EnvironmentUnderSettings, variables of options the settings
+    // already have a value for are skipped.
+    QString environmentPrefix() const;
+    void setEnvironmentPrefix(const QString &prefix);
+    void setEnvironmentVariable(const QString &option,
+                                const QString &variable);
+    EnvironmentPrecedence environmentPrecedence() const;
+    void setEnvironmentPrecedence(EnvironmentPrecedence precedence);
+
+    // Argument lists of at least parallelThreshold() tokens can have their
+    // tokens looked up on several threads before they are parsed; what is
+    // found is the same either way, and callbacks are still invoked on the
+    // calling thread, in order. A thread count of 0 means one per core. Only
+    // one thread is used by default, and always with response files.
+    int parsingThreadCount() const;
+    void setParsingThreadCount(int count);
+    int parallelThreshold() const;
+    void setParallelThreshold(int tokens);
+
+    bool abbreviationsEnabled() const;
+    void setAbbreviationsEnabled(bool enabled);
+
+    static bool statisticsEnabled();
+    Statistics statistics() const;
+    void resetStatistics();
+
     Settings *settings() const;
     void setSettings(Settings *s);
 
@@ -63,6 +358,47 @@ public:
 
     QIODevice *stdOut() const;
     QIODevice *stdErr() const;
+
+private:
+    void addBoundOption(const QString &name, const QChar &alias,
+                        OptionFlags flags, const ValueBinding &binding);
+
+    template <typename Functor>
+    struct FunctorThunk
+    {
+        static void invoke(void *context, CommandLineParser *parser,
+                           ParsingResult result, const QString &name,
+                           QVariant value, bool *stop)
+        {
+            (*static_cast<Functor *>(context))(
+                        parser, result, name, value, stop);
+        }
+    };
+
+    template <typename T>
+    struct MemberThunk
+    {
+        typedef void (T::*Callback)(CommandLineParser *, ParsingResult,
+                                    const QString &, QVariant, bool *);
+        MemberThunk(T *obj, Callback callback) :
+            obj(obj), callback(callback) {}
+
+        static void invoke(void *context, CommandLineParser *parser,
+                           ParsingResult result, const QString &name,
+                           QVariant value, bool *stop)
+        {
+            MemberThunk *self = static_cast<MemberThunk *>(context);
+            (self->obj->*self->callback)(parser, result, name, value, stop);
+        }
+
+        T *obj;
+        Callback callback;
+    };
+
+    bool parseWithThunk(const QList<QString> &arguments,
+                        ParsingThunk thunk, void *context);
+    bool parseWithThunk(int argc, char *argv[],
+                        ParsingThunk thunk, void *context);
 };
 
 }   // namespace QCli
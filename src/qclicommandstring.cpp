@@ -0,0 +1,158 @@
+#include "qclicommandstring_p.h"
+
+namespace QCli
+{
+
+namespace
+{
+
+// Carriage returns count as blanks too, so that commands read line by line
+// from a socket need not be trimmed.
+inline bool isBlank(ushort c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Characters that end the part of a word that can be taken as is.
+inline bool isSpecial(ushort c)
+{
+    return isBlank(c) || c == '\\' || c == '\'' || c == '"';
+}
+
+// Characters a backslash escapes inside double quotes.
+inline bool isEscapedInQuotes(ushort c)
+{
+    return c == '$' || c == '`' || c == '"' || c == '\\' || c == '\n';
+}
+
+}   // namespace
+
+CommandStringSource::CommandStringSource(const QString &command) :
+    command(command), unescaped(), words(), errorPosition(-1)
+{
+    split();
+}
+
+void CommandStringSource::split()
+{
+    const QChar *data = command.constData();
+    int size = command.size();
+    QChar *out = 0;
+    int i = 0;
+    while (i < size)
+    {
+        ushort c = data[i].unicode();
+        if (isBlank(c))
+        {
+            i++;
+            continue;
+        }
+        if (c == '#')
+        {
+            while (i < size && data[i].unicode() != '\n')
+                i++;
+            continue;
+        }
+        if (c == '\\' && i + 1 < size && data[i + 1].unicode() == '\n')
+        {
+            i += 2;
+            continue;
+        }
+
+        // Most words are taken as they are.
+        int begin = i;
+        while (i < size && !isSpecial(data[i].unicode()))
+            i++;
+        if (i == size || isBlank(data[i].unicode()))
+        {
+            if (begin == 0 && i == size)
+                words.append(ArgumentRef(command));
+            else
+                words.append(ArgumentRef(data + begin, i - begin));
+            continue;
+        }
+
+        // Unescaped words never take more room than the command, so one
+        // buffer of that size holds all of them.
+        if (!out)
+        {
+            unescaped.resize(size);
+            out = unescaped.data();
+        }
+        i = unescapeWord(begin, &out);
+        if (i < 0)
+            return;
+    }
+}
+
+// Writes the word starting at position to *out, and returns where it ends, or
+// -1 if it has no end.
+int CommandStringSource::unescapeWord(int position, QChar **out)
+{
+    const QChar *data = command.constData();
+    int size = command.size();
+    QChar *begin = *out;
+    QChar *p = begin;
+    int i = position;
+    while (i < size && !isBlank(data[i].unicode()))
+    {
+        ushort c = data[i].unicode();
+        if (c == '\\')
+        {
+            if (i + 1 == size)
+            {
+                errorPosition = i;
+                return -1;
+            }
+            if (data[i + 1].unicode() != '\n')
+                *p++ = data[i + 1];
+            i += 2;
+        }
+        else if (c == '\'')
+        {
+            int quote = i++;
+            while (i < size && data[i].unicode() != '\'')
+                *p++ = data[i++];
+            if (i == size)
+            {
+                errorPosition = quote;
+                return -1;
+            }
+            i++;
+        }
+        else if (c == '"')
+        {
+            int quote = i++;
+            for (;;)
+            {
+                if (i == size)
+                {
+                    errorPosition = quote;
+                    return -1;
+                }
+                c = data[i].unicode();
+                if (c == '"')
+                    break;
+                if (c == '\\' && i + 1 < size &&
+                        isEscapedInQuotes(data[i + 1].unicode()))
+                {
+                    if (data[i + 1].unicode() != '\n')
+                        *p++ = data[i + 1];
+                    i += 2;
+                    continue;
+                }
+                *p++ = data[i++];
+            }
+            i++;
+        }
+        else
+        {
+            *p++ = data[i++];
+        }
+    }
+    words.append(ArgumentRef(begin, int(p - begin)));
+    *out = p;
+    return i;
+}
+
+}   // namespace QCli
@@ -0,0 +1,66 @@
+#ifndef QCLICOMMANDSTRING_P_H
+#define QCLICOMMANDSTRING_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QString>
+#include <QVarLengthArray>
+#include "qcliargumentref_p.h"
+
+namespace QCli
+{
+
+// Splits a command given as one string into words, following the quoting
+// rules of a POSIX shell: words are separated by unquoted blanks, a backslash
+// keeps the next character as is, '...' keeps everything up to the closing
+// quote, and "..." does the same except that a backslash escapes $, `, ",
+// \ and newline. Backslash-newline joins lines, and a word starting with #
+// comments out the rest of its line. Nothing is expanded, and operators such
+// as ; or | are ordinary characters.
+//
+// Words without quotes or backslashes are views into the command; the others
+// are unescaped into one buffer, allocated only if needed. Like the argument
+// sources of the parser, the words can be parsed right away.
+class CommandStringSource
+{
+public:
+    explicit CommandStringSource(const QString &command);
+
+    // Whether the whole command could be split. If not (because of a quote
+    // that is not closed, or a backslash at the end), errorToken() is the
+    // rest of the command from there.
+    inline bool isValid() const { return errorPosition < 0; }
+    inline ArgumentRef errorToken() const
+    {
+        return ArgumentRef(command.constData() + errorPosition,
+                           command.size() - errorPosition);
+    }
+
+    inline bool has(int i) const { return i < words.size(); }
+    inline ArgumentRef at(int i) const { return words[i]; }
+    inline bool isError(int) const { return false; }
+    inline int size() const { return words.size(); }
+
+    // A command is not run with the environment of this process.
+    enum { UsesEnvironment = 0 };
+
+private:
+    void split();
+    int unescapeWord(int position, QChar **out);
+
+    const QString &command;
+    QString unescaped;      // Never resized once words point into it.
+    QVarLengthArray<ArgumentRef, 32> words;
+    int errorPosition;
+};
+
+}   // namespace QCli
+
+#endif // QCLICOMMANDSTRING_P_H
@@ -24,6 +24,23 @@ Q_FLAGS(OptionFlags)
 Q_DECLARE_FLAGS(OptionFlags, OptionFlag)
 Q_DECLARE_OPERATORS_FOR_FLAGS(OptionFlags)
 
+// Plain aggregate so that option tables can be declared as static constant
+// arrays, and registered at once with CommandLineParser::addOptions():
+//
+//     static const QCli::OptionDescription options[] = {
+//         {"verbose", 'v', QCli::OptionValueNone},
+//         {"jobs",    'j', QCli::OptionValueRequired},
+//     };
+//     parser->addOptions(options);
+//
+// An alias of 0 means the option has no alias.
+struct OptionDescription
+{
+    const char *name;
+    char alias;
+    int flags;
+};
+
 }   // namespace QCli
 
 #endif // QCLIOPTION_H
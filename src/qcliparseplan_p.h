@@ -0,0 +1,81 @@
+#ifndef QCLIPARSEPLAN_P_H
+#define QCLIPARSEPLAN_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QString>
+#include <QVector>
+#include "qclioption.h"
+#include "qcliperfecthash_p.h"
+#include "qcliprefixtrie_p.h"
+#include "qclivaluebinding.h"
+
+namespace QCli
+{
+
+// One dictionary key, resolved to everything the parser needs to know about
+// it. Entries are indexed the same way as the keys of the dictionary.
+struct PlanEntry
+{
+    enum Kind
+    {
+        OptionEntry,
+        GroupEntry,
+    };
+
+    PlanEntry() :
+        name(), kind(OptionEntry), mode(OptionSwitch), negative(false),
+        scoped(false), option(-1), group(-1) {}
+
+    QString name;       // Positive option name, or group name.
+    quint8 kind;
+    quint8 mode;        // OptionSwitch, OptionValueRequired/Optional.
+    bool negative;      // Key is the "--no-" form of the option.
+    bool scoped;        // Only valid in subcommands, even if none is entered.
+    int option;         // Registration index of the option.
+    ValueBinding binding;   // Set if the value is written into a variable.
+    int group;          // Index of the group, for group entries.
+};
+
+// Everything the parser reads while parsing, compiled from the registered
+// options and groups. The plan is never modified once compiled, only
+// replaced as a whole.
+struct ParsePlan
+{
+    ParsePlan() : dictionaryValid(false), groupWords(0) {}
+
+    // Whether the option of entry belongs to the group with index group.
+    inline bool isInGroup(int entry, int group) const
+    {
+        quint32 word = groupBits.at(entry * groupWords + group / 32);
+        return word & (1u << (group % 32));
+    }
+
+    PerfectHash dictionary;
+    PrefixTrie prefixes;
+    bool dictionaryValid;
+
+    QVector<PlanEntry> entries;
+    QVector<QString> keys;          // Dictionary keys, as entries.
+    QVector<QString> optionNames;   // Indexed by registration index.
+    QVector<QString> groupNames;
+
+    // Group membership bitmask of each entry, groupWords words per entry.
+    QVector<quint32> groupBits;
+    int groupWords;
+
+    // Environment variables mapped to options, and the entry of each.
+    PerfectHash environment;
+    QVector<int> environmentEntries;
+};
+
+}   // namespace QCli
+
+#endif // QCLIPARSEPLAN_P_H
@@ -0,0 +1,156 @@
+#include "qcliparseresult.h"
+#include "qcliparseresult_p.h"
+
+namespace QCli
+{
+
+ParseResult::ParseResult() : d(new ParseResultData)
+{
+}
+
+ParseResult::ParseResult(const ParseResult &other) : d(other.d)
+{
+}
+
+ParseResult::~ParseResult()
+{
+}
+
+ParseResult &ParseResult::operator=(const ParseResult &other)
+{
+    d = other.d;
+    return *this;
+}
+
+void ParseResult::swap(ParseResult &other)
+{
+    qSwap(d, other.d);
+}
+
+bool ParseResult::isSuccess() const
+{
+    return d->errors.isEmpty();
+}
+
+int ParseResult::optionCount() const
+{
+    return d->optionIndexes.size();
+}
+
+const int *ParseResult::optionIndexes() const
+{
+    return d->optionIndexes.constData();
+}
+
+const ParseResult::Span *ParseResult::optionValues() const
+{
+    return d->optionValues.constData();
+}
+
+int ParseResult::argumentCount() const
+{
+    return d->arguments.size();
+}
+
+const ParseResult::Span *ParseResult::arguments() const
+{
+    return d->arguments.constData();
+}
+
+int ParseResult::errorCount() const
+{
+    return d->errors.size();
+}
+
+const ParseResult::Error *ParseResult::errors() const
+{
+    return d->errors.constData();
+}
+
+const QChar *ParseResult::buffer() const
+{
+    return d->buffer.constData();
+}
+
+QString ParseResult::text(const Span &span) const
+{
+    return d->buffer.mid(span.offset, span.length);
+}
+
+QString ParseResult::optionName(int i) const
+{
+    return d->optionNames.value(d->optionIndexes.at(i));
+}
+
+QString ParseResult::optionValue(int i) const
+{
+    return text(d->optionValues.at(i));
+}
+
+QString ParseResult::argument(int i) const
+{
+    return text(d->arguments.at(i));
+}
+
+QString ParseResult::errorName(int i) const
+{
+    return text(d->errors.at(i).name);
+}
+
+QString ParseResult::groupName() const
+{
+    return d->group;
+}
+
+int ParseResult::lastIndexOf(int optionIndex) const
+{
+    const int *indexes = d->optionIndexes.constData();
+    for (int i = d->optionIndexes.size() - 1; i >= 0; i--)
+    {
+        if (indexes[i] == optionIndex)
+            return i;
+    }
+    return -1;
+}
+
+bool ParseResult::contains(const QString &name) const
+{
+    return lastIndexOf(optionIndexOf(name)) >= 0;
+}
+
+QString ParseResult::value(
+        const QString &name, const QString &defaultValue) const
+{
+    int i = lastIndexOf(optionIndexOf(name));
+    if (i < 0)
+        return defaultValue;
+    return optionValue(i);
+}
+
+QStringList ParseResult::values(const QString &name) const
+{
+    QStringList values;
+    int optionIndex = optionIndexOf(name);
+    for (int i = 0; i < d->optionIndexes.size(); i++)
+    {
+        if (d->optionIndexes.at(i) == optionIndex)
+            values << optionValue(i);
+    }
+    return values;
+}
+
+QStringList ParseResult::argumentList() const
+{
+    QStringList arguments;
+    foreach (const Span &span, d->arguments)
+        arguments << text(span);
+    return arguments;
+}
+
+int ParseResult::optionIndexOf(const QString &name) const
+{
+    // Not found is -1, which never matches an option index either.
+    return d->optionNames.indexOf(name);
+}
+
+}   // namespace QCli
@@ -0,0 +1,91 @@
+#ifndef QCLIPARSERESULT_H
+#define QCLIPARSERESULT_H
+
+#include <QMetaType>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QStringList>
+#include "qcli_global.h"
+#include "qclicommandlineparser.h"
+
+namespace QCli
+{
+
+class ParseResultData;
+
+// Everything CommandLineParser::parseAll() found, stored column by column:
+// the index of each option found, the span of its value, the spans of the
+// positional arguments, and the errors. All text lives in one buffer the
+// spans point into, so copying a result, or handing it to another thread,
+// never copies individual entries.
+class QCLIISHARED_EXPORT ParseResult
+{
+public:
+    // A range of characters in buffer().
+    struct Span
+    {
+        int offset;
+        int length;
+    };
+
+    struct Error
+    {
+        CommandLineParser::ParsingResult result;
+        int token;      // Index of the offending token in the arguments.
+        Span name;      // Option name, or the token as given.
+    };
+
+    ParseResult();
+    ParseResult(const ParseResult &other);
+    ~ParseResult();
+    ParseResult &operator=(const ParseResult &other);
+    void swap(ParseResult &other);
+
+    bool isSuccess() const;
+
+    // Options in the order they were found. An option's index is the order
+    // in which it was registered (see CommandLineParser::optionIndex()).
+    // Switches have "true" or "false" as their value.
+    int optionCount() const;
+    const int *optionIndexes() const;
+    const Span *optionValues() const;
+
+    int argumentCount() const;
+    const Span *arguments() const;
+
+    int errorCount() const;
+    const Error *errors() const;
+
+    const QChar *buffer() const;
+    QString text(const Span &span) const;
+
+    // Convenience accessors. Unlike the columns above, these allocate.
+    QString optionName(int i) const;
+    QString optionValue(int i) const;
+    QString argument(int i) const;
+    QString errorName(int i) const;
+    QString groupName() const;
+
+    // Position of the last occurrence of the option in the option columns,
+    // or -1 if it was not found.
+    int lastIndexOf(int optionIndex) const;
+    bool contains(const QString &name) const;
+    QString value(const QString &name,
+                  const QString &defaultValue = QString()) const;
+    QStringList values(const QString &name) const;
+    QStringList argumentList() const;
+
+private:
+    friend class ParseResultBuilder;
+    int optionIndexOf(const QString &name) const;
+
+    QSharedDataPointer<ParseResultData> d;
+};
+
+}   // namespace QCli
+
+Q_DECLARE_TYPEINFO(QCli::ParseResult::Span, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(QCli::ParseResult::Error, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(QCli::ParseResult)
+
+#endif // QCLIPARSERESULT_H
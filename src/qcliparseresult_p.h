@@ -0,0 +1,37 @@
+#ifndef QCLIPARSERESULT_P_H
+#define QCLIPARSERESULT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QSharedData>
+#include <QString>
+#include <QVector>
+#include "qcliparseresult.h"
+
+namespace QCli
+{
+
+class ParseResultData : public QSharedData
+{
+public:
+    QVector<int> optionIndexes;
+    QVector<ParseResult::Span> optionValues;
+    QVector<ParseResult::Span> arguments;
+    QVector<ParseResult::Error> errors;
+    QString buffer;
+
+    // Shared with the parse plan, to name the option indexes.
+    QVector<QString> optionNames;
+    QString group;
+};
+
+}   // namespace QCli
+
+#endif // QCLIPARSERESULT_P_H
@@ -0,0 +1,124 @@
+#include "qcliperfecthash_p.h"
+#include <QtAlgorithms>
+
+namespace QCli
+{
+
+namespace
+{
+
+// Average number of keys per bucket. Smaller buckets are easier to place,
+// but need more displacement entries.
+static const int KeysPerBucket = 4;
+
+// Give up (and let the caller fall back) after this many seeds. In practice
+// the first seed almost always works; failures mean duplicate keys.
+static const quint32 MaxSeeds = 64;
+
+struct BucketOrder
+{
+    BucketOrder(const QVector<QVector<int> > &buckets) : buckets(buckets) {}
+    bool operator()(int a, int b) const
+    {
+        return buckets.at(a).size() > buckets.at(b).size();
+    }
+    const QVector<QVector<int> > &buckets;
+};
+
+}   // namespace
+
+bool PerfectHash::build(const QVector<QString> &keys)
+{
+    clear();
+    if (keys.isEmpty())
+        return true;
+
+    this->keys = keys;
+    for (quint32 s = 0; s < MaxSeeds; s++)
+    {
+        if (tryBuild(s))
+            return true;
+    }
+    clear();
+    return false;
+}
+
+void PerfectHash::clear()
+{
+    seed = 0;
+    bucketCount = 0;
+    mask = 0;
+    keys.clear();
+    displacements.clear();
+    table.clear();
+}
+
+bool PerfectHash::tryBuild(quint32 s)
+{
+    int count = keys.size();
+
+    // Leave about 20% of the slots free so that the last buckets still find
+    // room quickly. A power of two keeps the final modulo a mask.
+    quint32 size = 1;
+    while (size < quint32(count + count / 4 + 1))
+        size <<= 1;
+
+    seed = s;
+    mask = size - 1;
+    bucketCount = qMax(1, count / KeysPerBucket);
+
+    QVector<quint32> hashes(count);
+    QVector<QVector<int> > buckets(bucketCount);
+    for (int i = 0; i < count; i++)
+    {
+        hashes[i] = hash(ArgumentRef(keys.at(i)), seed);
+        buckets[hashes.at(i) % bucketCount].append(i);
+    }
+
+    // Place the largest buckets first, while there is still room.
+    QVector<int> order(bucketCount);
+    for (int b = 0; b < order.size(); b++)
+        order[b] = b;
+    qSort(order.begin(), order.end(), BucketOrder(buckets));
+
+    table.fill(-1, size);
+    displacements.fill(0, bucketCount);
+
+    QVector<quint32> positions;
+    foreach (int b, order)
+    {
+        const QVector<int> &members = buckets.at(b);
+        if (members.isEmpty())
+            break;
+
+        // Since f2 is odd and the size a power of two, trying every
+        // displacement visits every slot for each key.
+        bool placed = false;
+        for (quint32 d = 0; !placed && d < size; d++)
+        {
+            positions.clear();
+            placed = true;
+            foreach (int i, members)
+            {
+                quint32 position = slot(hashes.at(i), d, mask);
+                if (table.at(position) >= 0 || positions.contains(position))
+                {
+                    placed = false;
+                    break;
+                }
+                positions.append(position);
+            }
+            if (placed)
+            {
+                displacements[b] = d;
+                for (int j = 0; j < members.size(); j++)
+                    table[positions.at(j)] = members.at(j);
+            }
+        }
+        if (!placed)
+            return false;
+    }
+    return true;
+}
+
+}   // namespace QCli
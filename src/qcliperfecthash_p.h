@@ -0,0 +1,82 @@
+#ifndef QCLIPERFECTHASH_P_H
+#define QCLIPERFECTHASH_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QString>
+#include <QVector>
+#include "qcliargumentref_p.h"
+
+namespace QCli
+{
+
+// A collision-free ("perfect") hash over a fixed set of keys, built with the
+// hash-and-displace scheme: keys are first spread into small buckets, and
+// each bucket then gets a displacement that moves all its keys into free
+// slots. A lookup costs one pass over the key, a little arithmetic, and one
+// comparison against the only candidate; it never allocates.
+class PerfectHash
+{
+public:
+    PerfectHash() : seed(0), bucketCount(0), mask(0) {}
+
+    // Returns false if no perfect hash could be found (e.g. duplicate keys).
+    bool build(const QVector<QString> &keys);
+    void clear();
+
+    inline bool isEmpty() const { return keys.isEmpty(); }
+
+    // Index of key in the vector given to build(), or -1. The view must be
+    // either decoded or pure ASCII, since it is hashed per code unit.
+    inline int indexOf(const ArgumentRef &key) const
+    {
+        if (keys.isEmpty())
+            return -1;
+        quint32 h = hash(key, seed);
+        quint32 displacement = displacements.at(h % bucketCount);
+        int index = table.at(slot(h, displacement, mask));
+        if (index < 0 || !(key == keys.at(index)))
+            return -1;
+        return index;
+    }
+
+private:
+    static inline quint32 hash(const ArgumentRef &key, quint32 seed)
+    {
+        // FNV-1a over UTF-16 code units.
+        quint32 h = 2166136261u ^ seed;
+        for (int i = 0; i < key.size(); i++)
+        {
+            h ^= key.at(i);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    static inline quint32 slot(quint32 h, quint32 displacement, quint32 mask)
+    {
+        quint32 f1 = (h ^ (h >> 15)) * 0x2c1b3c6du;
+        quint32 f2 = ((h ^ (h >> 13)) * 0x297a2d39u) | 1u;
+        return (f1 + displacement * f2) & mask;
+    }
+
+    bool tryBuild(quint32 seed);
+
+    quint32 seed;
+    quint32 bucketCount;
+    quint32 mask;
+    QVector<QString> keys;
+    QVector<quint32> displacements;
+    QVector<int> table;
+};
+
+}   // namespace QCli
+
+#endif // QCLIPERFECTHASH_P_H
@@ -0,0 +1,93 @@
+#include "qcliprefixtrie_p.h"
+
+namespace QCli
+{
+
+static inline int mergeUnique(int a, int b)
+{
+    if (a == PrefixTrie::NotFound)
+        return b;
+    if (b == PrefixTrie::NotFound)
+        return a;
+    return PrefixTrie::Ambiguous;
+}
+
+void PrefixTrie::build(const QVector<QString> &keys)
+{
+    clear();
+    nodes.append(Node());
+
+    for (int i = 0; i < keys.size(); i++)
+    {
+        const QString &key = keys.at(i);
+        int node = 0;
+        for (int j = 0; j < key.size(); j++)
+        {
+            ushort ch = key.at(j).unicode();
+            int next = child(node, ch);
+            if (next < 0)
+            {
+                next = nodes.size();
+                nodes.append(Node(ch));
+                nodes[next].nextSibling = nodes.at(node).firstChild;
+                nodes[node].firstChild = next;
+            }
+            node = next;
+        }
+        nodes[node].value = i;
+    }
+
+    // Children are always appended after their parent, so walking backwards
+    // sees every subtree before the node that owns it.
+    for (int node = nodes.size() - 1; node >= 0; node--)
+    {
+        int unique = nodes.at(node).value;
+        for (int c = nodes.at(node).firstChild; c >= 0;
+             c = nodes.at(c).nextSibling)
+            unique = mergeUnique(unique, nodes.at(c).unique);
+        nodes[node].unique = unique;
+    }
+}
+
+void PrefixTrie::clear()
+{
+    nodes.clear();
+}
+
+int PrefixTrie::find(const ArgumentRef &key) const
+{
+    int node = walk(key);
+    return node < 0 ? NotFound : nodes.at(node).value;
+}
+
+int PrefixTrie::findPrefix(const ArgumentRef &prefix) const
+{
+    int node = walk(prefix);
+    if (node < 0)
+        return NotFound;
+    if (nodes.at(node).value != NotFound)
+        return nodes.at(node).value;
+    return nodes.at(node).unique;
+}
+
+int PrefixTrie::walk(const ArgumentRef &key) const
+{
+    if (nodes.isEmpty())
+        return -1;
+    int node = 0;
+    for (int i = 0; node >= 0 && i < key.size(); i++)
+        node = child(node, key.at(i));
+    return node;
+}
+
+int PrefixTrie::child(int node, ushort ch) const
+{
+    for (int c = nodes.at(node).firstChild; c >= 0; c = nodes.at(c).nextSibling)
+    {
+        if (nodes.at(c).ch == ch)
+            return c;
+    }
+    return -1;
+}
+
+}   // namespace QCli
@@ -0,0 +1,66 @@
+#ifndef QCLIPREFIXTRIE_P_H
+#define QCLIPREFIXTRIE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QString>
+#include <QVector>
+#include "qcliargumentref_p.h"
+
+namespace QCli
+{
+
+// A prefix tree over a fixed set of keys, stored as one flat node array.
+// Every node remembers whether its subtree holds exactly one key, so that
+// resolving a unique prefix is a single walk over the query.
+class PrefixTrie
+{
+public:
+    enum
+    {
+        NotFound = -1,
+        Ambiguous = -2,
+    };
+
+    void build(const QVector<QString> &keys);
+    void clear();
+
+    inline bool isEmpty() const { return nodes.isEmpty(); }
+
+    // Index of the key in the vector given to build(), or NotFound.
+    int find(const ArgumentRef &key) const;
+
+    // Like find(), but if there is no exact match, returns the only key that
+    // starts with prefix, or Ambiguous if there are several.
+    int findPrefix(const ArgumentRef &prefix) const;
+
+private:
+    struct Node
+    {
+        Node(ushort ch = 0) :
+            ch(ch), firstChild(-1), nextSibling(-1), value(NotFound),
+            unique(NotFound) {}
+
+        ushort ch;
+        int firstChild;
+        int nextSibling;
+        int value;      // Key ending at this node.
+        int unique;     // Only key in this subtree, NotFound, or Ambiguous.
+    };
+
+    int walk(const ArgumentRef &key) const;
+    int child(int node, ushort ch) const;
+
+    QVector<Node> nodes;
+};
+
+}   // namespace QCli
+
+#endif // QCLIPREFIXTRIE_P_H
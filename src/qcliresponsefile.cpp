@@ -0,0 +1,126 @@
+#include "qcliresponsefile_p.h"
+#include <cstring>
+#include <QFile>
+
+namespace QCli
+{
+
+namespace
+{
+
+// Deeper nesting is most likely a response file including itself.
+static const int MaxDepth = 16;
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+            c == '\v' || c == '\f';
+}
+
+}   // namespace
+
+ResponseFileReader::ResponseFileReader(int format, qint64 sizeLimit) :
+    format(format), sizeLimit(sizeLimit), totalSize(0)
+{
+}
+
+ResponseFileReader::~ResponseFileReader()
+{
+    qDeleteAll(files);
+}
+
+bool ResponseFileReader::open(const ArgumentRef &path)
+{
+    if (frames.size() >= MaxDepth)
+        return false;
+
+    QFile *file = new QFile(path.toString());
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        delete file;
+        return false;
+    }
+    files.append(file);
+
+    Frame frame;
+    frame.file = file;
+    frame.data = 0;
+    frame.size = file->size();
+    frame.position = 0;
+    if (frame.size > 0)
+        frame.data = reinterpret_cast<const char *>(file->map(0, frame.size));
+
+    // Not everything can be mapped (e.g. pipes); read those instead.
+    if (!frame.data)
+    {
+        qint64 limit = sizeLimit > 0 ? sizeLimit - totalSize + 1 : 0;
+        QByteArray data = limit > 0 ? file->read(limit) : file->readAll();
+        contents.append(data);
+        frame.data = contents.last().constData();
+        frame.size = data.size();
+    }
+
+    // A file rejected here is not read, so it does not count.
+    if (sizeLimit > 0 && frame.size > sizeLimit - totalSize)
+        return false;
+    totalSize += frame.size;
+    frames.append(frame);
+    return true;
+}
+
+bool ResponseFileReader::next(ArgumentRef *token)
+{
+    Q_ASSERT(!frames.isEmpty());
+    Frame &frame = frames.last();
+    const char *data = frame.data;
+    qint64 size = frame.size;
+    qint64 position = frame.position;
+    qint64 begin = 0;
+    qint64 end = 0;
+
+    switch (format)
+    {
+    case Nul:
+    {
+        // Empty tokens count, except after a final NUL.
+        if (position >= size)
+            break;
+        begin = position;
+        const void *nul = memchr(data + begin, '\0', size - begin);
+        end = nul ? static_cast<const char *>(nul) - data : size;
+        position = end + 1;
+        break;
+    }
+    case Lines:
+        while (position < size && begin == end)
+        {
+            begin = position;
+            const void *newline = memchr(data + begin, '\n', size - begin);
+            end = newline ? static_cast<const char *>(newline) - data : size;
+            position = end + 1;
+            if (end > begin && data[end - 1] == '\r')
+                end--;
+        }
+        break;
+    default:
+        while (position < size && isSpace(data[position]))
+            position++;
+        begin = position;
+        while (position < size && !isSpace(data[position]))
+            position++;
+        end = position;
+        break;
+    }
+
+    bool found = (format == Nul) ? frame.position < size : begin < end;
+    if (!found)
+    {
+        frames.removeLast();
+        return false;
+    }
+    frame.position = position;
+    *token = ArgumentRef(data + begin, int(end - begin));
+    return true;
+}
+
+}   // namespace QCli
@@ -0,0 +1,167 @@
+#ifndef QCLIRESPONSEFILE_P_H
+#define QCLIRESPONSEFILE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QByteArray>
+#include <QList>
+#include "qcliargumentref_p.h"
+
+class QFile;
+
+namespace QCli
+{
+
+// Tokenizes response files in place. Files are memory-mapped (or read, if
+// they cannot be mapped), and the tokens handed out are views into them;
+// they stay valid for as long as the reader exists.
+class ResponseFileReader
+{
+public:
+    enum Format
+    {
+        Whitespace,     // Separated by any run of whitespace.
+        Lines,          // One per line. Empty lines are skipped.
+        Nul,            // Separated by NUL characters, like xargs -0.
+    };
+
+    ResponseFileReader(int format, qint64 sizeLimit);
+    ~ResponseFileReader();
+
+    // Starts reading the file, before continuing with any file being read.
+    // Fails if the file cannot be read, response files nest too deeply, or
+    // the size limit would be exceeded.
+    bool open(const ArgumentRef &path);
+
+    inline bool isReading() const { return !frames.isEmpty(); }
+
+    // Takes the next token of the innermost file. Returns false, and closes
+    // the file, if the file has no tokens left.
+    bool next(ArgumentRef *token);
+
+private:
+    struct Frame
+    {
+        QFile *file;
+        const char *data;
+        qint64 size;
+        qint64 position;
+    };
+
+    int format;
+    qint64 sizeLimit;
+    qint64 totalSize;
+    QList<Frame> frames;
+
+    // Files are only closed with the reader, since their tokens are still
+    // referenced after the file has been read to its end.
+    QList<QFile *> files;
+    QList<QByteArray> contents;     // Of files that could not be mapped.
+};
+
+// Wraps an argument source, and replaces each @path token by the tokens of
+// the response file at path, as the parser advances. Only a few tokens are
+// kept around, so response files of any size can be parsed.
+template <typename Source>
+class ResponseFileSource
+{
+public:
+    ResponseFileSource(const Source &source, int format, qint64 sizeLimit) :
+        source(source), sourceIndex(0), reader(format, sizeLimit), produced(0)
+    {
+    }
+
+    inline bool has(int i) const
+    {
+        while (produced <= i)
+        {
+            if (!produce())
+                return false;
+        }
+        return true;
+    }
+
+    inline ArgumentRef at(int i) const
+    {
+        return token(i).ref;
+    }
+
+    enum { UsesEnvironment = Source::UsesEnvironment };
+
+    // Whether the token is the path of a response file that could not be
+    // read.
+    inline bool isError(int i) const
+    {
+        return token(i).error;
+    }
+
+private:
+    struct Token
+    {
+        Token() : ref(), error(false) {}
+        ArgumentRef ref;
+        bool error;
+    };
+
+    // The parser looks at most one token ahead.
+    enum { WindowSize = 4 };
+
+    inline const Token &token(int i) const
+    {
+        Q_ASSERT(i < produced && i >= produced - WindowSize);
+        return window[i % WindowSize];
+    }
+
+    bool produce() const
+    {
+        for (;;)
+        {
+            Token &token = window[produced % WindowSize];
+            token = Token();
+            bool expand = true;
+            if (reader.isReading())
+            {
+                if (!reader.next(&token.ref))
+                    continue;
+            }
+            else if (source.has(sourceIndex))
+            {
+                // The first token is the command name, never a response file.
+                expand = sourceIndex > 0;
+                token.ref = source.at(sourceIndex++);
+            }
+            else
+            {
+                return false;
+            }
+
+            if (expand && token.ref.size() > 1 && token.ref.at(0) == '@')
+            {
+                token.ref = token.ref.mid(1);
+                if (reader.open(token.ref))
+                    continue;
+                token.error = true;
+            }
+            produced++;
+            return true;
+        }
+    }
+
+    // The parser only ever reads the source, but reading it advances it.
+    const Source &source;
+    mutable int sourceIndex;
+    mutable ResponseFileReader reader;
+    mutable Token window[WindowSize];
+    mutable int produced;
+};
+
+}   // namespace QCli
+
+#endif // QCLIRESPONSEFILE_P_H
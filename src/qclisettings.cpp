@@ -1,14 +1,100 @@
 #include "qclisettings.h"
+#include <QBitArray>
+#include <QMetaMethod>
+#include <QPointer>
+#include <QReadWriteLock>
 #include <QSet>
 #include <QSettings>
 #include <QStringList>
+#include <QVector>
 #include "qclioption.h"
+#include "qclisettingssnapshot_p.h"
+#include "qclisettingswatcher_p.h"
+#include "qclistatistics_p.h"
 
 namespace QCli
 {
 
 static QString ArgumentsKey = "38f9b7b0-755f-11e4-82f8-0800200c9a66";
 
+namespace
+{
+
+// Also takes -1, the id of a key never interned.
+inline bool testBit(const QBitArray &bits, int i)
+{
+    return uint(i) < uint(bits.size()) && bits.testBit(i);
+}
+
+inline void setBit(QBitArray *bits, int i, bool value = true)
+{
+    if (i >= bits->size())
+    {
+        if (!value)
+            return;
+        bits->resize(qMax(i + 1, bits->size() * 2));
+    }
+    bits->setBit(i, value);
+}
+
+// Settings files may name keys like the options they set.
+inline QString stripOptionPrefix(const QString &key)
+{
+    if (key.startsWith(OptionNamePrefix))
+        return key.mid(OptionNamePrefix.size());
+    if (key.startsWith(OptionAliasPrefix))
+        return key.mid(OptionAliasPrefix.size());
+    return key;
+}
+
+}   // namespace
+
+// A receiver of the keys changed by reloads, and the keys matching its
+// filter in the reload being reported.
+struct SettingsSubscription
+{
+    QString filter;
+    QPointer<QObject> receiver;
+    QMetaMethod method;
+    QStringList keys;
+};
+
+// Maps every key used in a settings tree (a root and all settings below it)
+// to a small integer, so that each node can keep its values in arrays indexed
+// by it. Keys are never removed. ArgumentsKey is always there, as ArgumentsId.
+class SettingsKeyTable : public QSharedData
+{
+public:
+    enum { ArgumentsId = 0 };
+
+    SettingsKeyTable()
+    {
+        intern(ArgumentsKey);
+    }
+
+    inline int find(const QString &key) const
+    {
+        return ids.value(key, -1);
+    }
+
+    int intern(const QString &key)
+    {
+        QHash<QString, int>::const_iterator it = ids.constFind(key);
+        if (it != ids.constEnd())
+            return it.value();
+        int id = keys.size();
+        keys.append(key);
+        ids.insert(key, id);
+        return id;
+    }
+
+    inline const QString &key(int id) const { return keys.at(id); }
+
+private:
+    QHash<QString, int> ids;
+    QVector<QString> keys;
+};
+
 class SettingsPrivate
 {
     Q_DECLARE_PUBLIC(Settings)
@@ -17,17 +103,280 @@ class SettingsPrivate
 public:
     SettingsPrivate(Settings *q, const QString &name,
                     Settings *parentSettings = 0) :
-        q_ptr(q), name(name), parentSettings(parentSettings)
+        q_ptr(q), name(name), parentSettings(parentSettings),
+        keys(parentSettings ? parentSettings->d_ptr->keys :
+                              QExplicitlySharedDataPointer<SettingsKeyTable>(
+                                  new SettingsKeyTable())),
+        valueCount(0), snapshotEnabled(false), resolvedGeneration(0),
+        generation(0), watcher(0), reloadDelay(100)
+    {
+        if (parentSettings)
+            parentSettings->d_ptr->childSettings.append(q);
+
+        // Not through q->registerArray(); q->d_ptr is not set up yet.
+        setBit(&arrayKeys, SettingsKeyTable::ArgumentsId);
+    }
+
+    inline bool hasLocalValue(int id) const
+    {
+        return testBit(hasValue, id);
+    }
+    inline QVariant localValue(int id) const
     {
-        q->registerArray(ArgumentsKey);
+        return hasLocalValue(id) ? values.at(id) : QVariant();
     }
+    void setLocalValue(int id, const QVariant &value);
+    bool removeLocalValue(int id);
+    void clearLocalValues();
+
+    // The local values and array keys by name, as the snapshot keeps them.
+    QHash<QString, QVariant> localValues() const;
+    QSet<QString> arrayKeyNames() const;
+
+    QVariant resolve(int id) const;
+    void valueChanged(int id);
+    void invalidate();
+
+    // Adds a value read from a settings file to the values by id, the way
+    // load() would set it.
+    void mergeValue(const QString &key, const QVariant &value,
+                    QVector<QVariant> *merged, QBitArray *present) const;
+    void notify(const QStringList &keys);
 
     QString name;
     Settings *parentSettings;
-    QHash<QString, QVariant> values;
-    QSet<QString> arrayKeys;
+    QList<Settings *> childSettings;
+    QExplicitlySharedDataPointer<SettingsKeyTable> keys;
+
+    // Values set on this node, indexed by key id. Only ids with their bit
+    // set in hasValue have one; the others are null, or past the end.
+    QVector<QVariant> values;
+    QBitArray hasValue;
+    int valueCount;
+    QBitArray arrayKeys;
+    bool snapshotEnabled;
+
+    // Keys changed or removed since the values were last in sync with the
+    // settings file named syncedFileName.
+    mutable QBitArray dirtyKeys;
+    mutable QString syncedFileName;
+    mutable Settings::SaveStatistics saveStatistics;
+
+    // Values as seen from this node, i.e. with the parent chain resolved and
+    // arrays merged, filled in as they are looked up. Changing a value drops
+    // it from the node and its descendants; wholesale changes bump the
+    // generation instead, and the cache is discarded when next used.
+    // Lookups share cacheLock while the value is cached, and take it for
+    // writing to fill it in; so do the statistics counters.
+    mutable QReadWriteLock cacheLock;
+    mutable QVector<QVariant> resolved;
+    mutable QBitArray isResolved;
+    mutable quint32 resolvedGeneration;
+    quint32 generation;
+
+    mutable Settings::Statistics statistics;
+
+    SettingsWatcher *watcher;
+    int reloadDelay;
+
+    // Subscriptions by filter, so that matching a changed key costs a lookup
+    // for the key and each group it is in, however many subscribers there
+    // are.
+    QList<SettingsSubscription *> subscriptions;
+    QMultiHash<QString, SettingsSubscription *> subscriptionFilters;
 };
 
+void SettingsPrivate::setLocalValue(int id, const QVariant &value)
+{
+    if (id >= values.size())
+        values.resize(id + 1);
+    values[id] = value;
+    if (!hasLocalValue(id))
+    {
+        setBit(&hasValue, id);
+        valueCount++;
+    }
+}
+
+bool SettingsPrivate::removeLocalValue(int id)
+{
+    if (!hasLocalValue(id))
+        return false;
+    values[id] = QVariant();
+    hasValue.clearBit(id);
+    valueCount--;
+    return true;
+}
+
+void SettingsPrivate::clearLocalValues()
+{
+    values.clear();
+    hasValue.clear();
+    valueCount = 0;
+}
+
+QHash<QString, QVariant> SettingsPrivate::localValues() const
+{
+    QHash<QString, QVariant> result;
+    result.reserve(valueCount);
+    for (int id = 0; id < values.size(); id++)
+    {
+        if (hasLocalValue(id))
+            result.insert(keys->key(id), values.at(id));
+    }
+    return result;
+}
+
+QSet<QString> SettingsPrivate::arrayKeyNames() const
+{
+    QSet<QString> result;
+    for (int id = 0; id < arrayKeys.size(); id++)
+    {
+        if (arrayKeys.testBit(id))
+            result.insert(keys->key(id));
+    }
+    return result;
+}
+
+QVariant SettingsPrivate::resolve(int id) const
+{
+    if (!testBit(arrayKeys, id))
+    {
+        for (const Settings *p = q_ptr; p; p = p->parentSettings())
+        {
+            if (p != q_ptr)
+                QCLI_COUNT(statistics.parentHops);
+            if (p->d_ptr->hasLocalValue(id))
+                return p->d_ptr->values.at(id);
+        }
+        return QVariant();
+    }
+    QList<QVariant> values;
+    for (const Settings *p = q_ptr; p; p = p->parentSettings())
+    {
+        if (p != q_ptr)
+            QCLI_COUNT(statistics.parentHops);
+        values.append(p->d_ptr->localValue(id).toList());
+    }
+    return values;
+}
+
+void SettingsPrivate::valueChanged(int id)
+{
+    setBit(&isResolved, id, false);
+    foreach (Settings *child, childSettings)
+        child->d_ptr->valueChanged(id);
+}
+
+void SettingsPrivate::invalidate()
+{
+    generation++;
+    foreach (Settings *child, childSettings)
+        child->d_ptr->invalidate();
+}
+
+void SettingsPrivate::mergeValue(const QString &key, const QVariant &value,
+                                 QVector<QVariant> *merged,
+                                 QBitArray *present) const
+{
+    int id = keys->intern(stripOptionPrefix(key));
+    if (id >= merged->size())
+    {
+        merged->resize(id + 1);
+        present->resize(id + 1);
+    }
+    QVariant &target = (*merged)[id];
+    if (!testBit(arrayKeys, id))
+    {
+        target = value;
+    }
+    else
+    {
+        QList<QVariant> list = target.toList();
+        if (value.type() == QVariant::List)
+            list.append(value.toList());
+        else
+            list.append(value);
+        target = list;
+    }
+    present->setBit(id);
+}
+
+void SettingsPrivate::notify(const QStringList &keys)
+{
+    // Collect the keys of each subscriber first, so that each is called
+    // once, and may subscribe or unsubscribe while being called.
+    QList<SettingsSubscription *> matched;
+    foreach (const QString &key, keys)
+    {
+        int slash = key.size();
+        for (;;)
+        {
+            QString filter = key.left(slash);
+            if (slash < key.size())
+                filter.append(QChar('/'));
+            if (slash <= 0)
+                filter.clear();
+            typedef QMultiHash<QString, SettingsSubscription *>::iterator Iter;
+            Iter it = subscriptionFilters.find(filter);
+            for (; it != subscriptionFilters.end() && it.key() == filter; it++)
+            {
+                if (it.value()->keys.isEmpty())
+                    matched.append(it.value());
+                it.value()->keys.append(key);
+            }
+            if (slash <= 0)
+                break;
+            slash = key.lastIndexOf(QChar('/'), slash - 1);
+        }
+    }
+
+    // A receiver subscribed with several filters gets the keys of all of
+    // them in one call, each key once.
+    QList<QPointer<QObject> > receivers;
+    QList<QMetaMethod> methods;
+    QList<QStringList> matchedKeys;
+    foreach (SettingsSubscription *subscription, matched)
+    {
+        int i = 0;
+        while (i < receivers.size() &&
+               (receivers.at(i) != subscription->receiver ||
+                methods.at(i).methodIndex() !=
+                    subscription->method.methodIndex()))
+            i++;
+        if (i == receivers.size())
+        {
+            receivers.append(subscription->receiver);
+            methods.append(subscription->method);
+            matchedKeys.append(QStringList());
+        }
+        QStringList &keys = matchedKeys[i];
+        if (keys.isEmpty())
+        {
+            keys = subscription->keys;
+        }
+        else
+        {
+            QSet<QString> seen;
+            foreach (const QString &key, keys)
+                seen.insert(key);
+            foreach (const QString &key, subscription->keys)
+            {
+                if (!seen.contains(key))
+                    keys.append(key);
+            }
+        }
+        subscription->keys.clear();
+    }
+    for (int i = 0; i < receivers.size(); i++)
+    {
+        if (receivers.at(i))
+            methods.at(i).invoke(receivers.at(i).data(),
+                                 Q_ARG(QStringList, matchedKeys.at(i)));
+    }
+    emit q_ptr->changed(keys);
+}
+
 Settings::Settings(const QString &name, Settings *parent) :
     QObject(parent), d_ptr(new SettingsPrivate(this, name, parent))
 {
@@ -40,9 +389,22 @@ Settings::Settings(const QString &name, QObject *parent) :
 
 Settings::~Settings()
 {
+    // Children are deleted (as QObject children) after us; make sure they
+    // do not reach back.
+    foreach (Settings *child, d_ptr->childSettings)
+        child->d_ptr->parentSettings = 0;
+    if (d_ptr->parentSettings)
+        d_ptr->parentSettings->d_ptr->childSettings.removeOne(this);
+    delete d_ptr->watcher;
+    qDeleteAll(d_ptr->subscriptions);
     delete d_ptr;
 }
 
+QString Settings::name() const
+{
+    return d_ptr->name;
+}
+
 Settings *Settings::parentSettings() const
 {
     return d_ptr->parentSettings;
@@ -51,7 +413,45 @@ Settings *Settings::parentSettings() const
 void Settings::load(QSettings *settings)
 {
     Q_D(Settings);
-    d->values.clear();
+    QCLI_COUNT(d->statistics.loads);
+    d->clearLocalValues();
+    d->invalidate();
+    d->dirtyKeys.clear();
+    d->syncedFileName = settings->fileName();
+
+    // Take the values from the snapshot of the settings file if it is still
+    // up to date. Otherwise go through QSettings, and take a new snapshot.
+    // Only the file is checked, so values from fallbacks are never taken
+    // from a snapshot, and changes not written to the file yet are written
+    // first. QSettings reads the file while syncing; it is stamped on either
+    // side, and there is no snapshot if it changed in between.
+    QString source;
+    SettingsSnapshot::Stamp stamp;
+    QSet<QString> arrayKeys;
+    if (d->snapshotEnabled && !hasFallbacks(settings))
+    {
+        SettingsSnapshot::Stamp before;
+        bool stamped = SettingsSnapshot::stamp(settings->fileName(), &before);
+        settings->sync();
+        if (stamped && settings->status() == QSettings::NoError &&
+                SettingsSnapshot::stamp(settings->fileName(), &stamp) &&
+                stamp == before)
+        {
+            source = settings->fileName();
+            arrayKeys = d->arrayKeyNames();
+        }
+    }
+    QHash<QString, QVariant> snapshot;
+    if (!source.isEmpty() &&
+            SettingsSnapshot::read(source, stamp, arrayKeys, &snapshot))
+    {
+        QCLI_COUNT(d->statistics.snapshotLoads);
+        typedef QHash<QString, QVariant>::const_iterator Iter;
+        for (Iter it = snapshot.constBegin(); it != snapshot.constEnd(); it++)
+            d->setLocalValue(d->keys->intern(it.key()), it.value());
+        return;
+    }
+
     foreach (QString key, settings->allKeys())
     {
         QVariant value = settings->value(key);
@@ -60,89 +460,362 @@ void Settings::load(QSettings *settings)
             QHash<QString, QVariant> hash = value.toHash();
             typedef QHash<QString, QVariant>::const_iterator Iter;
             for (Iter it = hash.constBegin(); it != hash.constEnd(); it++)
-            {
-                QString key = it.key();
-                if (key.startsWith(OptionNamePrefix))
-                    key = key.mid(OptionNamePrefix.size());
-                else if (key.startsWith(OptionAliasPrefix))
-                    key = key.mid(OptionAliasPrefix.size());
-                setValue(key, it.value());
-            }
+                setValue(stripOptionPrefix(it.key()), it.value());
         }
         else
         {
-            if (key.startsWith(OptionNamePrefix))
-                key = key.mid(OptionNamePrefix.size());
-            else if (key.startsWith(OptionAliasPrefix))
-                key = key.mid(OptionAliasPrefix.size());
-            setValue(key, value);
+            setValue(stripOptionPrefix(key), value);
         }
     }
+
+    if (!source.isEmpty())
+        SettingsSnapshot::write(source, stamp, arrayKeys, d->localValues());
+
+    // Everything was just read from the file.
+    d->dirtyKeys.clear();
 }
 
 void Settings::save(QSettings *settings) const
 {
+    const SettingsPrivate *d = d_func();
+    QCLI_COUNT(d->statistics.saves);
+    Settings::SaveStatistics statistics;
+
+    QString fileName = settings->fileName();
+    if (fileName.isEmpty() || fileName != d->syncedFileName)
+    {
+        for (int id = 0; id < d->values.size(); id++)
+        {
+            if (d->hasLocalValue(id))
+                settings->setValue(d->keys->key(id), d->values.at(id));
+        }
+        statistics.keysWritten = d->valueCount;
+    }
+    else
+    {
+        for (int id = 0; id < d->dirtyKeys.size(); id++)
+        {
+            if (!d->dirtyKeys.testBit(id))
+                continue;
+            if (d->hasLocalValue(id))
+            {
+                settings->setValue(d->keys->key(id), d->values.at(id));
+                statistics.keysWritten++;
+            }
+            else
+            {
+                settings->remove(d->keys->key(id));
+                statistics.keysRemoved++;
+            }
+        }
+    }
+
+    if (statistics.keysWritten || statistics.keysRemoved)
+        settings->sync();
+    d->dirtyKeys.clear();
+    d->syncedFileName = fileName;
+    d->saveStatistics = statistics;
+}
+
+Settings::SaveStatistics Settings::lastSaveStatistics() const
+{
+    return d_ptr->saveStatistics;
+}
+
+void Settings::watch(QSettings *settings)
+{
+    Q_D(Settings);
+    load(settings);
+    delete d->watcher;
+    d->watcher = new SettingsWatcher(this, SettingsSource(settings),
+                                     d->reloadDelay);
+}
+
+void Settings::unwatch()
+{
+    Q_D(Settings);
+    delete d->watcher;
+    d->watcher = 0;
+}
+
+bool Settings::isWatching() const
+{
+    return d_ptr->watcher;
+}
+
+int Settings::reloadDelay() const
+{
+    return d_ptr->reloadDelay;
+}
+
+void Settings::setReloadDelay(int milliseconds)
+{
+    Q_D(Settings);
+    d->reloadDelay = milliseconds;
+    if (d->watcher)
+        d->watcher->setDelay(milliseconds);
+}
+
+void Settings::subscribe(const QString &filter, QObject *receiver,
+                         const char *member)
+{
+    Q_D(Settings);
+    QString sig = QString("%1(QStringList)").arg(member);
+    const QMetaObject *meta = receiver->metaObject();
+    int index = meta->indexOfMethod(
+                QMetaObject::normalizedSignature(qPrintable(sig)));
+
+    // Make sure the method signature is correct.
+    Q_ASSERT(index >= 0);
+    if (index < 0)
+        return;
+
+    SettingsSubscription *subscription = new SettingsSubscription;
+    subscription->filter = filter;
+    subscription->receiver = receiver;
+    subscription->method = meta->method(index);
+    d->subscriptions.append(subscription);
+    d->subscriptionFilters.insert(filter, subscription);
+}
+
+void Settings::unsubscribe(QObject *receiver)
+{
+    Q_D(Settings);
+
+    // Subscriptions of receivers deleted meanwhile go, too.
+    for (int i = d->subscriptions.size() - 1; i >= 0; i--)
+    {
+        SettingsSubscription *subscription = d->subscriptions.at(i);
+        if (subscription->receiver && subscription->receiver != receiver)
+            continue;
+        d->subscriptionFilters.remove(subscription->filter, subscription);
+        d->subscriptions.removeAt(i);
+        delete subscription;
+    }
+}
+
+void Settings::applyReload(const QVariantHash &values)
+{
+    Q_D(Settings);
+    QCLI_COUNT(d->statistics.reloads);
+
+    // The file's values by id, read the way load() reads them.
+    QVector<QVariant> merged;
+    QBitArray present;
     typedef QHash<QString, QVariant>::const_iterator Iter;
-    for (Iter it = d_ptr->values.constBegin();
-            it != d_ptr->values.constEnd(); it++)
-        settings->setValue(it.key(), it.value());
-    settings->sync();
+    for (Iter it = values.constBegin(); it != values.constEnd(); it++)
+    {
+        if (it.value().type() != QVariant::Hash)
+        {
+            d->mergeValue(it.key(), it.value(), &merged, &present);
+            continue;
+        }
+        QHash<QString, QVariant> hash = it.value().toHash();
+        for (Iter inner = hash.constBegin(); inner != hash.constEnd(); inner++)
+            d->mergeValue(inner.key(), inner.value(), &merged, &present);
+    }
+
+    // Only keys in sync with the file are its to change. The values taken
+    // are in sync with it again, so they are not marked dirty.
+    QStringList changed;
+    for (int id = 0; id < present.size(); id++)
+    {
+        if (!present.testBit(id) || testBit(d->dirtyKeys, id))
+            continue;
+        if (d->hasLocalValue(id) && d->values.at(id) == merged.at(id))
+            continue;
+        d->setLocalValue(id, merged.at(id));
+        d->valueChanged(id);
+        changed.append(d->keys->key(id));
+    }
+    for (int id = 0; id < d->values.size(); id++)
+    {
+        if (id == SettingsKeyTable::ArgumentsId || !d->hasLocalValue(id) ||
+                testBit(present, id) || testBit(d->dirtyKeys, id))
+            continue;
+        d->removeLocalValue(id);
+        d->valueChanged(id);
+        changed.append(d->keys->key(id));
+    }
+    if (!changed.isEmpty())
+        d->notify(changed);
+}
+
+Settings::Statistics::Statistics() :
+    lookups(0), cacheHits(0), parentHops(0), loads(0), snapshotLoads(0),
+    reloads(0), saves(0)
+{
+}
+
+Settings::Statistics Settings::statistics() const
+{
+    QReadLocker locker(&d_ptr->cacheLock);
+    return d_ptr->statistics;
+}
+
+void Settings::resetStatistics()
+{
+    Q_D(Settings);
+    QWriteLocker locker(&d->cacheLock);
+    d->statistics = Statistics();
+}
+
+Settings::KeyId Settings::keyId(const QString &key)
+{
+    Q_D(Settings);
+    return KeyId(d->keys->intern(key));
+}
+
+Settings::KeyId Settings::findKeyId(const QString &key) const
+{
+    return KeyId(d_ptr->keys->find(key));
+}
+
+QString Settings::keyName(KeyId key) const
+{
+    return key.isValid() ? d_ptr->keys->key(key.id) : QString();
 }
 
 QVariant Settings::value(const QString &key) const
 {
-    if (!d_ptr->arrayKeys.contains(key))
-        return settings(key)->localValue(key);
-    QList<QVariant> values;
-    for (const Settings *p = this; p; p = p->parentSettings())
-        values.append(p->localValue(key).toList());
-    return values;
+    // Keys never interned have no value anywhere in the tree.
+    return value(findKeyId(key));
+}
+
+QVariant Settings::value(KeyId key) const
+{
+    const SettingsPrivate *d = d_func();
+    int id = key.id;
+
+    // Counting needs the lookups serialized, so with statistics every lookup
+    // takes the lock for writing.
+#ifndef QCLI_STATISTICS
+    if (!key.isValid())
+        return QVariant();
+    {
+        QReadLocker locker(&d->cacheLock);
+        if (d->resolvedGeneration == d->generation &&
+                testBit(d->isResolved, id))
+            return d->resolved.at(id);
+    }
+#endif
+
+    QWriteLocker locker(&d->cacheLock);
+    QCLI_COUNT(d->statistics.lookups);
+    if (!key.isValid())
+        return QVariant();
+    if (d->resolvedGeneration != d->generation)
+    {
+        d->isResolved.clear();
+        d->resolvedGeneration = d->generation;
+    }
+    if (testBit(d->isResolved, id))
+    {
+        QCLI_COUNT(d->statistics.cacheHits);
+        return d->resolved.at(id);
+    }
+    QVariant value = d->resolve(id);
+    if (id >= d->resolved.size())
+        d->resolved.resize(id + 1);
+    d->resolved[id] = value;
+    setBit(&d->isResolved, id);
+    return value;
 }
 
 void Settings::setValue(const QString &key, const QVariant &value)
+{
+    setValue(keyId(key), value);
+}
+
+void Settings::setValue(KeyId key, const QVariant &value)
 {
     Q_D(Settings);
-    if (!d->arrayKeys.contains(key))
+    if (!key.isValid())
+        return;
+    if (!testBit(d->arrayKeys, key.id))
     {
         setLocalValue(key, value);
         return;
     }
-    QVariant var = d->values.value(key);
+    QVariant var = d->localValue(key.id);
     QList<QVariant> list = var.toList();
-    if (var.type() != QVariant::List)
-    {
-        if (!var.isNull())
-            list.append(var);
-        setLocalValue(key, list);
-    }
+    if (var.type() != QVariant::List && !var.isNull())
+        list.append(var);
     if (value.type() == QVariant::List)
         list.append(value.toList());
     else
         list.append(value);
+    setLocalValue(key, list);
+}
+
+bool Settings::isSnapshotEnabled() const
+{
+    return d_ptr->snapshotEnabled;
+}
+
+void Settings::setSnapshotEnabled(bool enabled)
+{
+    Q_D(Settings);
+    d->snapshotEnabled = enabled;
 }
 
 void Settings::registerArray(const QString &key)
 {
     Q_D(Settings);
-    d->arrayKeys.insert(key);
+    int id = d->keys->intern(key);
+    setBit(&d->arrayKeys, id);
+    setBit(&d->isResolved, id, false);
 }
 
 QVariant Settings::localValue(const QString &key) const
 {
-    return d_ptr->values.value(key);
+    return d_ptr->localValue(d_ptr->keys->find(key));
+}
+
+QVariant Settings::localValue(KeyId key) const
+{
+    return d_ptr->localValue(key.id);
 }
 
 void Settings::setLocalValue(const QString &key, const QVariant &value)
+{
+    setLocalValue(keyId(key), value);
+}
+
+void Settings::setLocalValue(KeyId key, const QVariant &value)
+{
+    Q_D(Settings);
+    if (!key.isValid())
+        return;
+    d->setLocalValue(key.id, value);
+    setBit(&d->dirtyKeys, key.id);
+    d->valueChanged(key.id);
+}
+
+void Settings::removeLocalValue(const QString &key)
+{
+    int id = d_ptr->keys->find(key);
+    if (id >= 0)
+        removeLocalValue(KeyId(id));
+}
+
+void Settings::removeLocalValue(KeyId key)
 {
     Q_D(Settings);
-    d->values.insert(key, value);
+    if (!d->removeLocalValue(key.id))
+        return;
+    setBit(&d->dirtyKeys, key.id);
+    d->valueChanged(key.id);
 }
 
 Settings *Settings::settings(const QString &value, const QString &key) const
 {
+    int id = d_ptr->keys->find(key);
+    if (id < 0)
+        return 0;
     for (Settings *p = const_cast<Settings *>(this); p; p = p->parentSettings())
     {
-        QList<QVariant> arguments = localValue(key).toList();
+        QList<QVariant> arguments = p->d_ptr->localValue(id).toList();
         foreach (const QVariant &v, arguments)
         {
             if (v.type() == QVariant::String && v.toString() == value)
@@ -154,9 +827,12 @@ Settings *Settings::settings(const QString &value, const QString &key) const
 
 Settings *Settings::settings(const QString &key) const
 {
+    int id = d_ptr->keys->find(key);
+    if (id < 0)
+        return 0;
     for (Settings *p = const_cast<Settings *>(this); p; p = p->parentSettings())
     {
-        if (p->d_ptr->values.contains(key))
+        if (p->d_ptr->hasLocalValue(id))
             return p;
     }
     return 0;
@@ -164,7 +840,7 @@ Settings *Settings::settings(const QString &key) const
 
 void Settings::addArgument(const QString &argument)
 {
-    setValue(ArgumentsKey, argument);
+    setValue(KeyId(SettingsKeyTable::ArgumentsId), argument);
 }
 
 }   // namespace QCli
@@ -2,6 +2,8 @@
 #define QCLISETTINGS_H
 
 #include <QObject>
+#include <QStringList>
+#include <QVariant>
 #include "qcli_global.h"
 class QSettings;
 
@@ -9,6 +11,7 @@ namespace QCli
 {
 
 class SettingsPrivate;
+class SettingsWatcher;
 
 class QCLIISHARED_EXPORT Settings : public QObject
 {
@@ -17,6 +20,53 @@ class QCLIISHARED_EXPORT Settings : public QObject
     SettingsPrivate * const d_ptr;
 
 public:
+    struct SaveStatistics
+    {
+        SaveStatistics() : keysWritten(0), keysRemoved(0) {}
+        int keysWritten;
+        int keysRemoved;
+    };
+
+    // Counters of this object since it was created or the statistics were
+    // reset. Like the parser statistics, only kept if the library is built
+    // with QCLI_STATISTICS defined.
+    struct QCLIISHARED_EXPORT Statistics
+    {
+        Statistics();
+
+        quint64 lookups;            // Calls to value().
+        quint64 cacheHits;
+        quint64 parentHops;         // Steps up the chain while resolving.
+        quint64 loads;
+        quint64 snapshotLoads;      // Loads served from the snapshot.
+        quint64 reloads;            // Of watched files.
+        quint64 saves;
+    };
+
+    // A key interned in the settings tree (the root settings and all
+    // settings below it). Values are kept in arrays indexed by key id, so
+    // looking them up by id does not hash the key. Callers doing so often
+    // can get the id once and keep it; it is only valid within the tree.
+    class KeyId
+    {
+    public:
+        inline KeyId() : id(-1) {}
+        inline bool isValid() const { return id >= 0; }
+        inline bool operator==(const KeyId &other) const
+        {
+            return id == other.id;
+        }
+        inline bool operator!=(const KeyId &other) const
+        {
+            return id != other.id;
+        }
+
+    private:
+        friend class Settings;
+        inline explicit KeyId(int id) : id(id) {}
+        int id;
+    };
+
     Settings(const QString &name, Settings *parent);
     Settings(const QString &name, QObject *parent = 0);
     ~Settings();
@@ -24,20 +74,80 @@ public:
     QString name() const;
     Settings *parentSettings() const;
 
+    // save() only writes the keys changed (or removed) since the last load()
+    // or save() with the same settings file. Any other settings object gets
+    // every key.
     void load(QSettings *settings);
     void save(QSettings *settings) const;
+    SaveStatistics lastSaveStatistics() const;
+
+    Statistics statistics() const;
+    void resetStatistics();
 
+    // Loads the settings file like load(), and then reloads it whenever it
+    // changes, reading it on a pool thread. A reload compares the values in
+    // the file to the local ones, takes those that differ, drops those no
+    // longer in the file, and emits changed() once with the keys it changed,
+    // if any. Keys set or removed here since the file was last loaded or
+    // saved are left alone, so values from the command line survive. Changes
+    // within reloadDelay() milliseconds of each other are read at once.
+    // Fallbacks are read again with the file, but only the file itself is
+    // watched. Reloading needs an event loop on the thread of this object.
+    void watch(QSettings *settings);
+    void unwatch();
+    bool isWatching() const;
+    int reloadDelay() const;
+    void setReloadDelay(int milliseconds);
+
+    // Calls receiver->member(QStringList) with the keys a reload changed
+    // that match filter: a key, a group ending in "/" for all keys in it, or
+    // an empty filter for every key. Each subscriber is called at most once
+    // per reload, and not at all if none of its keys changed.
+    void subscribe(const QString &filter, QObject *receiver,
+                   const char *member);
+    void unsubscribe(QObject *receiver);
+
+    // Whether load() keeps a binary snapshot next to the settings file
+    // (named like it, with ".qclisnapshot" appended), and reads that instead
+    // while the file is unchanged. Settings with fallbacks (see
+    // QSettings::setFallbacksEnabled()) are always read through QSettings,
+    // and pending changes are synced first. Disabled by default.
+    bool isSnapshotEnabled() const;
+    void setSnapshotEnabled(bool enabled);
+
+    // keyId() interns the key in the tree if it is not there yet, which
+    // changes the tree like setting a value does. findKeyId() only looks it
+    // up, and returns an invalid id for keys never interned.
+    KeyId keyId(const QString &key);
+    KeyId findKeyId(const QString &key) const;
+    QString keyName(KeyId key) const;
+
+    // Values may be read from several threads at once, e.g. by parses of a
+    // frozen parser, as long as nothing changes them meanwhile.
     QVariant value(const QString &key) const;
+    QVariant value(KeyId key) const;
     void setValue(const QString &key, const QVariant &value);
+    void setValue(KeyId key, const QVariant &value);
 
     void registerArray(const QString &key);
     QVariant localValue(const QString &key) const;
+    QVariant localValue(KeyId key) const;
     void setLocalValue(const QString &key, const QVariant &value);
+    void setLocalValue(KeyId key, const QVariant &value);
+    void removeLocalValue(const QString &key);
+    void removeLocalValue(KeyId key);
 
     Settings *settings(const QString &value, const QString &key) const;
     Settings *settings(const QString &key) const;
 
     void addArgument(const QString &argument);
+
+signals:
+    void changed(const QStringList &keys);
+
+private:
+    friend class SettingsWatcher;
+    void applyReload(const QVariantHash &values);
 };
 
 }   // namespace QCli
@@ -0,0 +1,499 @@
+#include "qclisettingssnapshot_p.h"
+#include <cstdio>
+#include <cstring>
+#include <QByteArray>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#if QT_VERSION >= 0x050100
+#include <QSaveFile>
+#else
+#include <QTemporaryFile>
+#endif
+#include <QStringList>
+#include <QVector>
+
+namespace QCli
+{
+
+namespace
+{
+
+static const quint32 Magic = 0x534c4351;    // "QCLS", in either byte order.
+static const quint32 Version = 1;
+
+// Lists nested deeper than this are not worth a snapshot.
+static const int MaxDepth = 16;
+
+struct Header
+{
+    quint32 magic;
+    quint32 version;
+    quint32 entryCount;
+    quint32 arrayKeyCount;
+    qint64 sourceModified;      // Milliseconds since epoch.
+    qint64 sourceSize;
+    quint32 sourceHash;
+    quint32 dataSize;
+};
+
+struct Entry
+{
+    quint32 keyOffset;          // Offsets are relative to the data.
+    quint32 keyLength;          // In UTF-16 code units.
+    quint32 valueOffset;
+    quint32 reserved;
+};
+
+struct Record
+{
+    enum Type
+    {
+        Invalid,
+        Bool,
+        Integer,    // length is the QVariant::Type of the value.
+        Double,
+        String,     // length is the number of characters.
+        StringList, // length is the number of elements.
+        List,
+        Stream,     // length is the number of bytes.
+    };
+
+    quint32 type;
+    quint32 length;
+};
+
+quint32 hashData(const char *data, qint64 size)
+{
+    // FNV-1a.
+    quint32 h = 2166136261u;
+    for (qint64 i = 0; i < size; i++)
+    {
+        h ^= uchar(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+quint32 hashFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+    qint64 size = file.size();
+    if (size <= 0)
+        return hashData(0, 0);
+    uchar *data = file.map(0, size);
+    if (data)
+        return hashData(reinterpret_cast<const char *>(data), size);
+    QByteArray contents = file.readAll();
+    return hashData(contents.constData(), contents.size());
+}
+
+class Writer
+{
+public:
+    quint32 addString(const QString &s)
+    {
+        align();
+        quint32 offset = data.size();
+        data.append(reinterpret_cast<const char *>(s.constData()),
+                    s.size() * sizeof(QChar));
+        return offset;
+    }
+
+    // Returns false if the value cannot be written.
+    bool addValue(const QVariant &value, quint32 *offset, int depth = 0)
+    {
+        if (depth > MaxDepth)
+            return false;
+
+        QVector<quint32> elements;
+        Record record;
+        record.type = Record::Invalid;
+        record.length = 0;
+        QByteArray payload;
+        switch (value.type())
+        {
+        case QVariant::Invalid:
+            break;
+        case QVariant::Bool:
+            record.type = Record::Bool;
+            payload = number(qint64(value.toBool()));
+            break;
+        case QVariant::Int:
+        case QVariant::LongLong:
+            record.type = Record::Integer;
+            record.length = value.type();
+            payload = number(value.toLongLong());
+            break;
+        case QVariant::UInt:
+        case QVariant::ULongLong:
+            record.type = Record::Integer;
+            record.length = value.type();
+            payload = number(qint64(value.toULongLong()));
+            break;
+        case QVariant::Double:
+        {
+            record.type = Record::Double;
+            double d = value.toDouble();
+            payload = QByteArray(reinterpret_cast<const char *>(&d),
+                                 sizeof(d));
+            break;
+        }
+        case QVariant::String:
+        {
+            QString s = value.toString();
+            record.type = Record::String;
+            record.length = s.size();
+            payload = QByteArray(
+                        reinterpret_cast<const char *>(s.constData()),
+                        s.size() * sizeof(QChar));
+            break;
+        }
+        case QVariant::StringList:
+        case QVariant::List:
+        {
+            record.type = value.type() == QVariant::List ?
+                        Record::List : Record::StringList;
+            QList<QVariant> list = value.toList();
+            record.length = list.size();
+            foreach (const QVariant &element, list)
+            {
+                quint32 elementOffset = 0;
+                if (!addValue(element, &elementOffset, depth + 1))
+                    return false;
+                elements.append(elementOffset);
+            }
+            payload = QByteArray(
+                        reinterpret_cast<const char *>(elements.constData()),
+                        elements.size() * sizeof(quint32));
+            break;
+        }
+        default:
+        {
+            record.type = Record::Stream;
+            QDataStream stream(&payload, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_4_6);
+            stream << value;
+            record.length = payload.size();
+            break;
+        }
+        }
+
+        align();
+        *offset = data.size();
+        data.append(reinterpret_cast<const char *>(&record), sizeof(record));
+        data.append(payload);
+        return true;
+    }
+
+    void align()
+    {
+        while (data.size() % 8)
+            data.append('\0');
+    }
+
+    QByteArray data;
+
+private:
+    static QByteArray number(qint64 n)
+    {
+        return QByteArray(reinterpret_cast<const char *>(&n), sizeof(n));
+    }
+};
+
+class Reader
+{
+public:
+    Reader(const uchar *data, quint32 size) : data(data), size(size) {}
+
+    bool readString(quint32 offset, quint32 length, QString *s) const
+    {
+        if (offset % sizeof(QChar) || !contains(offset, length * 2))
+            return false;
+        *s = QString(reinterpret_cast<const QChar *>(data + offset), length);
+        return true;
+    }
+
+    bool readValue(quint32 offset, QVariant *value, int depth = 0) const
+    {
+        if (depth > MaxDepth || offset % 8 ||
+                !contains(offset, sizeof(Record)))
+            return false;
+        Record record;
+        memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(record);
+
+        switch (record.type)
+        {
+        case Record::Invalid:
+            *value = QVariant();
+            return true;
+        case Record::Bool:
+        case Record::Integer:
+        {
+            qint64 n = 0;
+            if (!contains(offset, sizeof(n)))
+                return false;
+            memcpy(&n, data + offset, sizeof(n));
+            if (record.type == Record::Bool)
+                *value = bool(n);
+            else if (record.length == QVariant::Int)
+                *value = int(n);
+            else if (record.length == QVariant::UInt)
+                *value = uint(n);
+            else if (record.length == QVariant::ULongLong)
+                *value = quint64(n);
+            else
+                *value = n;
+            return true;
+        }
+        case Record::Double:
+        {
+            double d = 0.0;
+            if (!contains(offset, sizeof(d)))
+                return false;
+            memcpy(&d, data + offset, sizeof(d));
+            *value = d;
+            return true;
+        }
+        case Record::String:
+        {
+            QString s;
+            if (!readString(offset, record.length, &s))
+                return false;
+            *value = s;
+            return true;
+        }
+        case Record::StringList:
+        case Record::List:
+        {
+            if (!contains(offset, quint64(record.length) * sizeof(quint32)))
+                return false;
+            QList<QVariant> list;
+            QStringList strings;
+            for (quint32 i = 0; i < record.length; i++)
+            {
+                quint32 elementOffset = 0;
+                memcpy(&elementOffset, data + offset + i * sizeof(quint32),
+                       sizeof(quint32));
+                QVariant element;
+                if (!readValue(elementOffset, &element, depth + 1))
+                    return false;
+                if (record.type == Record::List)
+                    list.append(element);
+                else
+                    strings.append(element.toString());
+            }
+            if (record.type == Record::List)
+                *value = list;
+            else
+                *value = strings;
+            return true;
+        }
+        case Record::Stream:
+        {
+            if (!contains(offset, record.length))
+                return false;
+            QByteArray bytes = QByteArray::fromRawData(
+                        reinterpret_cast<const char *>(data + offset),
+                        record.length);
+            QDataStream stream(bytes);
+            stream.setVersion(QDataStream::Qt_4_6);
+            stream >> *value;
+            return stream.status() == QDataStream::Ok;
+        }
+        default:
+            return false;
+        }
+    }
+
+private:
+    inline bool contains(quint64 offset, quint64 length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    const uchar *data;
+    quint32 size;
+};
+
+bool writeAll(QIODevice *file, const Header &header,
+              const QVector<Entry> &entries, const QByteArray &data)
+{
+    if (file->write(reinterpret_cast<const char *>(&header), sizeof(header))
+            != sizeof(header))
+        return false;
+    qint64 tableSize = entries.size() * sizeof(Entry);
+    if (file->write(reinterpret_cast<const char *>(entries.constData()),
+                    tableSize) != tableSize)
+        return false;
+    return file->write(data) == data.size();
+}
+
+#if QT_VERSION < 0x050100
+// Puts the file at from in place of the one at to, if any.
+bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_UNIX
+    // Atomic, so there is always either the old or the new file at to.
+    return std::rename(QFile::encodeName(from).constData(),
+                       QFile::encodeName(to).constData()) == 0;
+#else
+    // Readers may find no snapshot for a moment, and read the source file.
+    QFile::remove(to);
+    return QFile::rename(from, to);
+#endif
+}
+#endif
+
+}   // namespace
+
+QString SettingsSnapshot::path(const QString &sourcePath)
+{
+    return sourcePath + QLatin1String(".qclisnapshot");
+}
+
+bool SettingsSnapshot::stamp(const QString &sourcePath, Stamp *stamp)
+{
+    QFileInfo source(sourcePath);
+    if (!source.isFile())
+        return false;
+    stamp->modified = source.lastModified().toMSecsSinceEpoch();
+    stamp->size = source.size();
+    stamp->hash = hashFile(sourcePath);
+    return true;
+}
+
+bool SettingsSnapshot::read(const QString &sourcePath, const Stamp &source,
+                            const QSet<QString> &arrayKeys,
+                            QHash<QString, QVariant> *values)
+{
+    QFile file(path(sourcePath));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 fileSize = file.size();
+    if (fileSize < qint64(sizeof(Header)))
+        return false;
+    const uchar *mapped = file.map(0, fileSize);
+    if (!mapped)
+        return false;
+
+    Header header;
+    memcpy(&header, mapped, sizeof(header));
+    if (header.magic != Magic || header.version != Version)
+        return false;
+    qint64 tableSize = qint64(header.entryCount + header.arrayKeyCount) *
+            sizeof(Entry);
+    if (qint64(sizeof(Header)) + tableSize + header.dataSize != fileSize)
+        return false;
+
+    if (header.sourceSize != source.size || header.sourceHash != source.hash)
+        return false;
+
+    const uchar *table = mapped + sizeof(Header);
+    Reader reader(table + tableSize, header.dataSize);
+    Entry entry;
+
+    // Values depend on the array keys registered when they were loaded.
+    QSet<QString> snapshotArrayKeys;
+    for (quint32 i = 0; i < header.arrayKeyCount; i++)
+    {
+        memcpy(&entry, table + (header.entryCount + i) * sizeof(Entry),
+               sizeof(entry));
+        QString key;
+        if (!reader.readString(entry.keyOffset, entry.keyLength, &key))
+            return false;
+        snapshotArrayKeys.insert(key);
+    }
+    if (snapshotArrayKeys != arrayKeys)
+        return false;
+
+    QHash<QString, QVariant> result;
+    result.reserve(header.entryCount);
+    for (quint32 i = 0; i < header.entryCount; i++)
+    {
+        memcpy(&entry, table + i * sizeof(Entry), sizeof(entry));
+        QString key;
+        QVariant value;
+        if (!reader.readString(entry.keyOffset, entry.keyLength, &key) ||
+                !reader.readValue(entry.valueOffset, &value))
+            return false;
+        result.insert(key, value);
+    }
+    *values = result;
+    return true;
+}
+
+bool SettingsSnapshot::write(const QString &sourcePath, const Stamp &source,
+                             const QSet<QString> &arrayKeys,
+                             const QHash<QString, QVariant> &values)
+{
+    if (source.size < 0)
+        return false;
+
+    Writer writer;
+    QVector<Entry> entries;
+    entries.reserve(values.size() + arrayKeys.size());
+    typedef QHash<QString, QVariant>::const_iterator Iter;
+    for (Iter it = values.constBegin(); it != values.constEnd(); it++)
+    {
+        Entry entry;
+        entry.keyOffset = writer.addString(it.key());
+        entry.keyLength = it.key().size();
+        entry.reserved = 0;
+        if (!writer.addValue(it.value(), &entry.valueOffset))
+            return false;
+        entries.append(entry);
+    }
+    foreach (const QString &key, arrayKeys)
+    {
+        Entry entry;
+        entry.keyOffset = writer.addString(key);
+        entry.keyLength = key.size();
+        entry.valueOffset = 0;
+        entry.reserved = 0;
+        entries.append(entry);
+    }
+    writer.align();
+
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.entryCount = values.size();
+    header.arrayKeyCount = arrayKeys.size();
+    header.sourceModified = source.modified;
+    header.sourceSize = source.size;
+    header.sourceHash = source.hash;
+    header.dataSize = writer.data.size();
+
+    // Write a temporary file of our own first, and move it in place in one
+    // step, so that a reader never sees a partial snapshot, and processes
+    // taking one at the same time do not write over each other.
+    QString target = path(sourcePath);
+#if QT_VERSION >= 0x050100
+    QSaveFile file(target);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    if (!writeAll(&file, header, entries, writer.data))
+    {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+#else
+    QTemporaryFile file(target + QLatin1String(".XXXXXX"));
+    if (!file.open())
+        return false;
+    bool ok = writeAll(&file, header, entries, writer.data);
+    file.close();
+    if (!ok || !replaceFile(file.fileName(), target))
+        return false;
+    file.setAutoRemove(false);
+    return true;
+#endif
+}
+
+}   // namespace QCli
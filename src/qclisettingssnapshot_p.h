@@ -0,0 +1,78 @@
+#ifndef QCLISETTINGSSNAPSHOT_P_H
+#define QCLISETTINGSSNAPSHOT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVariant>
+
+namespace QCli
+{
+
+// A binary image of the values Settings::load() read from a settings file,
+// stored next to that file. It is memory-mapped and copied out as is, without
+// going through QSettings (or parsing anything) again.
+//
+// Layout, in native byte order, with every record aligned to 8 bytes:
+//
+//     Header
+//     Entry[entryCount]        key and value of each setting
+//     Entry[arrayKeyCount]     array keys (no value)
+//     data                     strings (UTF-16) and value records
+//
+// A value record is a type and a length, followed by the payload: 8 bytes for
+// booleans and numbers, the characters of a string, the offsets of the
+// element records for lists, or the QDataStream form of anything else.
+//
+// The snapshot records a stamp of the source file (its modification time,
+// size and a hash), and the array keys registered when it was taken. It is
+// only used if the size, hash and array keys all still match; the
+// modification time alone does not tell that a file is unchanged.
+class SettingsSnapshot
+{
+public:
+    struct Stamp
+    {
+        Stamp() : modified(0), size(-1), hash(0) {}
+        inline bool operator==(const Stamp &other) const
+        {
+            return modified == other.modified && size == other.size &&
+                    hash == other.hash;
+        }
+        inline bool operator!=(const Stamp &other) const
+        {
+            return !(*this == other);
+        }
+
+        qint64 modified;            // Milliseconds since epoch.
+        qint64 size;
+        quint32 hash;
+    };
+
+    static QString path(const QString &sourcePath);
+
+    // Stamps the source file as it is now. To be taken before the values
+    // are read from it, so that changes made meanwhile leave the snapshot
+    // stale rather than holding the old values.
+    static bool stamp(const QString &sourcePath, Stamp *stamp);
+
+    static bool read(const QString &sourcePath, const Stamp &source,
+                     const QSet<QString> &arrayKeys,
+                     QHash<QString, QVariant> *values);
+    static bool write(const QString &sourcePath, const Stamp &source,
+                      const QSet<QString> &arrayKeys,
+                      const QHash<QString, QVariant> &values);
+};
+
+}   // namespace QCli
+
+#endif // QCLISETTINGSSNAPSHOT_P_H
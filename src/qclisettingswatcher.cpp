@@ -0,0 +1,104 @@
+#include "qclisettingswatcher_p.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QThreadPool>
+#include "qclisettings.h"
+
+namespace QCli
+{
+
+SettingsSource::SettingsSource(const QSettings *settings) :
+    fileName(settings->fileName()), format(settings->format()),
+    scope(settings->scope()), organization(settings->organizationName()),
+    application(settings->applicationName()),
+    fallbacks(hasFallbacks(settings))
+{
+}
+
+SettingsReader::SettingsReader(const SettingsSource &source) :
+    QObject(), source(source)
+{
+    setAutoDelete(false);
+}
+
+void SettingsReader::run()
+{
+    QVariantHash values;
+    {
+        // Opened on the file alone, settings with fallbacks would lose the
+        // values of the other files.
+        QScopedPointer<QSettings> settings(source.fallbacks ?
+                new QSettings(source.format, source.scope,
+                              source.organization, source.application) :
+                new QSettings(source.fileName, source.format));
+        foreach (const QString &key, settings->allKeys())
+            values.insert(key, settings->value(key));
+    }
+    emit finished(values);
+    deleteLater();
+}
+
+SettingsWatcher::SettingsWatcher(Settings *settings,
+                                 const SettingsSource &source, int delay) :
+    QObject(settings), settings(settings), source(source),
+    fileName(source.fileName), watcher(), timer(), reading(false),
+    changedWhileReading(false)
+{
+    timer.setSingleShot(true);
+    timer.setInterval(delay);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(read()));
+
+    // Editors (and QSettings) tend to replace the file instead of writing
+    // it in place, which ends the watch on it. The directory tells when the
+    // file is back.
+    connect(&watcher, SIGNAL(fileChanged(QString)),
+            this, SLOT(fileChanged()));
+    connect(&watcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(directoryChanged()));
+    watcher.addPath(QFileInfo(fileName).absolutePath());
+    if (QFile::exists(fileName))
+        watcher.addPath(fileName);
+}
+
+void SettingsWatcher::fileChanged()
+{
+    if (!watcher.files().contains(fileName) && QFile::exists(fileName))
+        watcher.addPath(fileName);
+    if (reading)
+        changedWhileReading = true;
+    else
+        timer.start();
+}
+
+void SettingsWatcher::directoryChanged()
+{
+    // Other files in the directory are none of our business.
+    if (watcher.files().contains(fileName) || !QFile::exists(fileName))
+        return;
+    fileChanged();
+}
+
+void SettingsWatcher::read()
+{
+    // Being replaced; the directory tells when the new file is there.
+    if (!QFile::exists(fileName))
+        return;
+    reading = true;
+    changedWhileReading = false;
+    SettingsReader *reader = new SettingsReader(source);
+    connect(reader, SIGNAL(finished(QVariantHash)),
+            this, SLOT(readFinished(QVariantHash)), Qt::QueuedConnection);
+    QThreadPool::globalInstance()->start(reader);
+}
+
+void SettingsWatcher::readFinished(const QVariantHash &values)
+{
+    reading = false;
+    settings->applyReload(values);
+    if (changedWhileReading)
+        timer.start();
+}
+
+}   // namespace QCli
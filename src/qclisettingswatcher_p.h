@@ -0,0 +1,100 @@
+#ifndef QCLISETTINGSWATCHER_P_H
+#define QCLISETTINGSWATCHER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QRunnable>
+#include <QSettings>
+#include <QString>
+#include <QTimer>
+#include <QVariant>
+
+namespace QCli
+{
+
+class Settings;
+
+// Whether values may come from other files than the one named by fileName(),
+// those of the organization or of the system. Settings opened on a file by
+// name have none.
+inline bool hasFallbacks(const QSettings *settings)
+{
+    return settings->fallbacksEnabled() &&
+            !settings->organizationName().isEmpty();
+}
+
+// Where a QSettings object takes its values from, so that they can be read
+// again the same way, fallbacks and all, on another thread.
+struct SettingsSource
+{
+    explicit SettingsSource(const QSettings *settings);
+
+    QString fileName;
+    QSettings::Format format;
+    QSettings::Scope scope;
+    QString organization;
+    QString application;
+    bool fallbacks;
+};
+
+// Reads all values of a settings source on a pool thread, as QSettings has
+// them, and hands them back through finished(). It deletes itself later on
+// its own thread, so whoever started it may be gone by then.
+class SettingsReader : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    explicit SettingsReader(const SettingsSource &source);
+
+    void run();
+
+signals:
+    void finished(const QVariantHash &values);
+
+private:
+    SettingsSource source;
+};
+
+// Watches the settings file of a Settings object, and has it reloaded when
+// the file changes. Changes arriving within the delay are taken together,
+// and so are changes arriving while the file is being read; only one read
+// runs at a time.
+class SettingsWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    SettingsWatcher(Settings *settings, const SettingsSource &source,
+                    int delay);
+
+    inline void setDelay(int delay) { timer.setInterval(delay); }
+
+private slots:
+    void fileChanged();
+    void directoryChanged();
+    void read();
+    void readFinished(const QVariantHash &values);
+
+private:
+    Settings *settings;
+    SettingsSource source;
+    QString fileName;
+    QFileSystemWatcher watcher;
+    QTimer timer;
+    bool reading;
+    bool changedWhileReading;
+};
+
+}   // namespace QCli
+
+#endif // QCLISETTINGSWATCHER_P_H
@@ -0,0 +1,49 @@
+#ifndef QCLISTATISTICS_P_H
+#define QCLISTATISTICS_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QtGlobal>
+#ifdef QCLI_STATISTICS
+#include <QElapsedTimer>
+#endif
+
+// Statistics counters cost nothing unless QCLI_STATISTICS is defined; the
+// counting expressions are not even evaluated otherwise.
+#ifdef QCLI_STATISTICS
+#  define QCLI_COUNT(counter) ((counter)++)
+#  define QCLI_COUNT_ADD(counter, n) ((counter) += (n))
+#  define QCLI_TIME(total) QCli::PhaseTimer phaseTimer(&(total))
+#else
+#  define QCLI_COUNT(counter) ((void)0)
+#  define QCLI_COUNT_ADD(counter, n) ((void)0)
+#  define QCLI_TIME(total) ((void)0)
+#endif
+
+namespace QCli
+{
+
+#ifdef QCLI_STATISTICS
+// Adds the time until it goes out of scope to total, in nanoseconds.
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(qint64 *total) : total(total) { timer.start(); }
+    ~PhaseTimer() { *total += timer.nsecsElapsed(); }
+
+private:
+    qint64 *total;
+    QElapsedTimer timer;
+};
+#endif
+
+}   // namespace QCli
+
+#endif // QCLISTATISTICS_P_H
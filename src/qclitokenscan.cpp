@@ -0,0 +1,114 @@
+#include "qclitokenscan_p.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QCLI_SSE2
+#endif
+
+namespace QCli
+{
+
+namespace
+{
+
+#ifdef QCLI_SSE2
+inline int lowestBit(int mask)
+{
+#if defined(Q_CC_GNU)
+    return __builtin_ctz(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+#endif
+
+// Local 8-bit data: look for '=' and for bytes outside ASCII.
+void scanNarrow(const char *data, int length, TokenScan *scan)
+{
+    int i = 0;
+    int high = 0;
+#ifdef QCLI_SSE2
+    const __m128i equal = _mm_set1_epi8('=');
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(data + i));
+        high |= _mm_movemask_epi8(chunk);
+        if (scan->equalSign < 0)
+        {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, equal));
+            if (mask)
+                scan->equalSign = i + lowestBit(mask);
+        }
+    }
+#endif
+    for (; i < length; i++)
+    {
+        uchar c = uchar(data[i]);
+        high |= c & 0x80;
+        if (c == '=' && scan->equalSign < 0)
+            scan->equalSign = i;
+    }
+    scan->ascii = !high;
+}
+
+// Decoded data only needs the '='.
+void scanWide(const ushort *data, int length, TokenScan *scan)
+{
+    int i = 0;
+#ifdef QCLI_SSE2
+    const __m128i equal = _mm_set1_epi16('=');
+    for (; i + 8 <= length; i += 8)
+    {
+        __m128i chunk = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, equal));
+        if (mask)
+        {
+            // Two mask bits per character.
+            scan->equalSign = i + lowestBit(mask) / 2;
+            return;
+        }
+    }
+#endif
+    for (; i < length; i++)
+    {
+        if (data[i] == '=')
+        {
+            scan->equalSign = i;
+            return;
+        }
+    }
+}
+
+}   // namespace
+
+TokenScan scanToken(const ArgumentRef &token)
+{
+    TokenScan scan;
+    scan.length = token.length;
+    scan.dashes = 0;
+    scan.equalSign = -1;
+    scan.ascii = true;
+
+    // Matches OptionNamePrefix and OptionAliasPrefix.
+    while (scan.dashes < 2 && scan.dashes < scan.length &&
+           token.at(scan.dashes) == '-')
+        scan.dashes++;
+
+    if (token.wide)
+        scanWide(reinterpret_cast<const ushort *>(token.wide), token.length,
+                 &scan);
+    else if (token.narrow)
+        scanNarrow(token.narrow, token.length, &scan);
+    return scan;
+}
+
+}   // namespace QCli
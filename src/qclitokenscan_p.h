@@ -0,0 +1,33 @@
+#ifndef QCLITOKENSCAN_P_H
+#define QCLITOKENSCAN_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QCli API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qcliargumentref_p.h"
+
+namespace QCli
+{
+
+// Everything the parser needs to know about the characters of a token before
+// looking it up, gathered in one pass over it (16 bytes at a time where SSE2
+// is available).
+struct TokenScan
+{
+    int length;
+    int dashes;         // Leading '-' characters, up to two.
+    int equalSign;      // Offset of the first '=', or -1.
+    bool ascii;         // Whether the token needs no decoding.
+};
+
+TokenScan scanToken(const ArgumentRef &token);
+
+}   // namespace QCli
+
+#endif // QCLITOKENSCAN_P_H
@@ -0,0 +1,145 @@
+#include "qclivaluebinding.h"
+#include <limits>
+#include <QByteArray>
+#include "qcliargumentref_p.h"
+
+namespace QCli
+{
+
+namespace
+{
+
+// Decimal integers with an optional sign, and nothing else (not even
+// whitespace). Fails on overflow instead of wrapping around.
+template <typename T>
+bool parseInteger(const ArgumentRef &value, T *result)
+{
+    int i = 0;
+    bool negative = false;
+    if (i < value.size() && (value.at(i) == '+' || value.at(i) == '-'))
+    {
+        negative = (value.at(i) == '-');
+        i++;
+    }
+    if (i == value.size())
+        return false;
+
+    // The magnitude of the minimum is one more than the maximum.
+    quint64 limit = quint64(std::numeric_limits<T>::max());
+    if (negative)
+        limit++;
+    quint64 magnitude = 0;
+    for (; i < value.size(); i++)
+    {
+        ushort c = value.at(i);
+        if (c < '0' || c > '9')
+            return false;
+        quint64 digit = c - '0';
+        if (magnitude > (limit - digit) / 10)
+            return false;
+        magnitude = magnitude * 10 + digit;
+    }
+
+    if (negative && magnitude)
+        *result = -T(magnitude - 1) - 1;
+    else
+        *result = T(magnitude);
+    return true;
+}
+
+// Copies a printable ASCII value into buffer, nul-terminated. Returns false
+// if the value does not fit, or contains anything else.
+bool toAscii(const ArgumentRef &value, char *buffer, int size)
+{
+    if (value.size() >= size)
+        return false;
+    for (int i = 0; i < value.size(); i++)
+    {
+        ushort c = value.at(i);
+        if (c <= ' ' || c >= 0x7f)
+            return false;
+        buffer[i] = char(c);
+    }
+    buffer[value.size()] = '\0';
+    return true;
+}
+
+}   // namespace
+
+namespace Internal
+{
+
+bool ValueConverter<int>::convert(
+        const ArgumentRef &value, const ValueBinding &binding)
+{
+    return parseInteger(value, static_cast<int *>(binding.target));
+}
+
+bool ValueConverter<qint64>::convert(
+        const ArgumentRef &value, const ValueBinding &binding)
+{
+    return parseInteger(value, static_cast<qint64 *>(binding.target));
+}
+
+bool ValueConverter<double>::convert(
+        const ArgumentRef &value, const ValueBinding &binding)
+{
+    // Anything longer than this is not a sensible number anyway.
+    char buffer[64];
+    if (value.isEmpty() || !toAscii(value, buffer, sizeof(buffer)))
+        return false;
+
+    // QByteArray conversions always use the C locale.
+    bool ok = false;
+    double result = QByteArray::fromRawData(buffer, value.size()).toDouble(&ok);
+    if (ok)
+        *static_cast<double *>(binding.target) = result;
+    return ok;
+}
+
+bool ValueConverter<bool>::convert(
+        const ArgumentRef &value, const ValueBinding &binding)
+{
+    *static_cast<bool *>(binding.target) = value.toBool();
+    return true;
+}
+
+bool ValueConverter<QString>::convert(
+        const ArgumentRef &value, const ValueBinding &binding)
+{
+    *static_cast<QString *>(binding.target) = value.toString();
+    return true;
+}
+
+bool ValueConverter<QStringList>::convert(
+        const ArgumentRef &value, const ValueBinding &binding)
+{
+    static_cast<QStringList *>(binding.target)->append(value.toString());
+    return true;
+}
+
+bool convertEnumValue(
+        const ArgumentRef &value, const QMetaEnum &enumerator, int *target)
+{
+    int result = 0;
+    if (parseInteger(value, &result))
+    {
+        if (!enumerator.valueToKey(result))
+            return false;
+        *target = result;
+        return true;
+    }
+
+    char key[128];
+    if (!toAscii(value, key, sizeof(key)))
+        return false;
+    result = enumerator.keyToValue(key);
+    if (result == -1 && qstrcmp(enumerator.valueToKey(-1), key) != 0)
+        return false;
+    *target = result;
+    return true;
+}
+
+}   // namespace Internal
+
+}   // namespace QCli
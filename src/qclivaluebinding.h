@@ -0,0 +1,106 @@
+#ifndef QCLIVALUEBINDING_H
+#define QCLIVALUEBINDING_H
+
+#include <QMetaEnum>
+#include <QString>
+#include <QStringList>
+#include "qcli_global.h"
+#include "qclioption.h"
+
+namespace QCli
+{
+
+class ArgumentRef;
+
+// Where the value of a bound option is written, and the converter that
+// writes it. See CommandLineParser::addOption().
+struct ValueBinding
+{
+    typedef bool (*Converter)(const ArgumentRef &value,
+                              const ValueBinding &binding);
+
+    ValueBinding() : convert(0), target(0), enumerator() {}
+
+    Converter convert;
+    void *target;
+    QMetaEnum enumerator;   // Enumerator the keys are taken from, for enums.
+};
+
+namespace Internal
+{
+
+// Converters for the types options can be bound to, picked at compile time.
+// They are locale-independent, and return false (leaving the target alone)
+// if the value cannot be converted. Other types have no converter, and do
+// not compile.
+template <typename T>
+struct ValueConverter;
+
+template <>
+struct QCLIISHARED_EXPORT ValueConverter<int>
+{
+    enum { DefaultFlags = OptionValueRequired };
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding);
+};
+
+template <>
+struct QCLIISHARED_EXPORT ValueConverter<qint64>
+{
+    enum { DefaultFlags = OptionValueRequired };
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding);
+};
+
+template <>
+struct QCLIISHARED_EXPORT ValueConverter<double>
+{
+    enum { DefaultFlags = OptionValueRequired };
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding);
+};
+
+// Reads the value the way the parser reads those of switches (see
+// ArgumentRef::toBool()): empty, "0" and "false", in any case, are false,
+// anything else is true.
+template <>
+struct QCLIISHARED_EXPORT ValueConverter<bool>
+{
+    enum { DefaultFlags = OptionSwitch };
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding);
+};
+
+template <>
+struct QCLIISHARED_EXPORT ValueConverter<QString>
+{
+    enum { DefaultFlags = OptionValueRequired };
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding);
+};
+
+// Appends every value, so that the option can be repeated.
+template <>
+struct QCLIISHARED_EXPORT ValueConverter<QStringList>
+{
+    enum { DefaultFlags = OptionValueRequired };
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding);
+};
+
+// Takes the key of an enumerator value, or the value as an integer.
+QCLIISHARED_EXPORT bool convertEnumValue(
+        const ArgumentRef &value, const QMetaEnum &enumerator, int *target);
+
+template <typename Enum>
+struct EnumConverter
+{
+    static bool convert(const ArgumentRef &value, const ValueBinding &binding)
+    {
+        int result = 0;
+        if (!convertEnumValue(value, binding.enumerator, &result))
+            return false;
+        *static_cast<Enum *>(binding.target) = static_cast<Enum>(result);
+        return true;
+    }
+};
+
+}   // namespace Internal
+
+}   // namespace QCli
+
+#endif // QCLIVALUEBINDING_H
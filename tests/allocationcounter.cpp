@@ -0,0 +1,124 @@
+#include "allocationcounter.h"
+#include <cstdlib>
+
+#if defined(__GLIBC__)
+
+#include <malloc.h>
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+}
+
+static bool counting = false;
+static quint64 allocations = 0;
+static qint64 liveBytes = 0;
+static qint64 peak = 0;
+
+// Blocks allocated before start() and freed while counting make this an
+// underestimate, never an overestimate.
+static inline void track(void *ptr, qint64 sign)
+{
+    if (!ptr)
+        return;
+    liveBytes += sign * qint64(malloc_usable_size(ptr));
+    if (liveBytes > peak)
+        peak = liveBytes;
+}
+
+extern "C" {
+
+void *malloc(size_t size) __THROW
+{
+    void *result = __libc_malloc(size);
+    if (counting)
+    {
+        allocations++;
+        track(result, 1);
+    }
+    return result;
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    void *result = __libc_calloc(count, size);
+    if (counting)
+    {
+        allocations++;
+        track(result, 1);
+    }
+    return result;
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+    if (counting)
+    {
+        allocations++;
+        track(ptr, -1);
+    }
+    void *result = __libc_realloc(ptr, size);
+    if (counting)
+        track(result, 1);
+    return result;
+}
+
+void free(void *ptr) __THROW
+{
+    if (counting)
+        track(ptr, -1);
+    __libc_free(ptr);
+}
+
+}
+
+bool AllocationCounter::isSupported()
+{
+    return true;
+}
+
+void AllocationCounter::start()
+{
+    allocations = 0;
+    liveBytes = 0;
+    peak = 0;
+    counting = true;
+}
+
+quint64 AllocationCounter::stop()
+{
+    counting = false;
+    return allocations;
+}
+
+qint64 AllocationCounter::peakBytes()
+{
+    return peak;
+}
+
+#else
+
+bool AllocationCounter::isSupported()
+{
+    return false;
+}
+
+void AllocationCounter::start()
+{
+}
+
+quint64 AllocationCounter::stop()
+{
+    return 0;
+}
+
+qint64 AllocationCounter::peakBytes()
+{
+    return 0;
+}
+
+#endif
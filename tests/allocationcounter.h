@@ -0,0 +1,22 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Counts calls into the global allocator (malloc, calloc, realloc; operator
+// new and Qt's containers all end up there) between start() and stop(), and
+// the most heap memory held at once on top of what was held at start().
+// Only supported with glibc, where the allocator can be interposed. The
+// counters are not synchronized, so they are approximate while other threads
+// allocate.
+namespace AllocationCounter
+{
+
+bool isSupported();
+void start();
+quint64 stop();
+qint64 peakBytes();
+
+}   // namespace AllocationCounter
+
+#endif // ALLOCATIONCOUNTER_H
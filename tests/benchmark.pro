@@ -0,0 +1,28 @@
+QT       += testlib
+
+QT       -= gui
+
+TARGET    = qclibenchmark
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE  = app
+
+include(../qcli.pri)
+
+INCLUDEPATH += $$PWD/../src
+
+SOURCES += \
+    benchmark_main.cpp \
+    allocationcounter.cpp \
+    benchmarkreport.cpp \
+    parserbenchmark.cpp \
+    settingsbenchmark.cpp \
+    qclitest.cpp
+
+HEADERS += \
+    allocationcounter.h \
+    benchmarkreport.h \
+    parserbenchmark.h \
+    settingsbenchmark.h \
+    qclitest.h
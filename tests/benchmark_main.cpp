@@ -0,0 +1,34 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include "benchmarkreport.h"
+#include "parserbenchmark.h"
+#include "settingsbenchmark.h"
+
+#define RUN(klass, args) \
+    { \
+        klass *obj = new klass(); \
+        status |= QTest::qExec(obj, args); \
+        delete obj; \
+    }
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // "-report <file>" is ours; everything else goes to QTest.
+    QStringList args = app.arguments();
+    int reportIndex = args.indexOf("-report");
+    if (reportIndex > 0 && reportIndex + 1 < args.size())
+    {
+        BenchmarkReport::open(args.at(reportIndex + 1));
+        args.removeAt(reportIndex);
+        args.removeAt(reportIndex);
+    }
+
+    int status = 0;
+    RUN(ParserBenchmark, args)
+    RUN(SettingsBenchmark, args)
+    if (!BenchmarkReport::close())
+        status |= 1;
+    return status;
+}
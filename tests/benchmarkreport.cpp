@@ -0,0 +1,103 @@
+#include "benchmarkreport.h"
+#include <QFile>
+#include <QTextStream>
+#include <QtTest>
+#include "allocationcounter.h"
+
+namespace
+{
+
+// Enough runs to average out timer resolution, without slowing the suite.
+static const qint64 MinimumTime = 100;      // Milliseconds.
+static const int MaximumRuns = 1000;
+
+QFile *reportFile = 0;
+
+QString field(const char *text)
+{
+    QString s = QString::fromUtf8(text ? text : "");
+    if (!s.contains(',') && !s.contains('"'))
+        return s;
+    s.replace("\"", "\"\"");
+    return "\"" + s + "\"";
+}
+
+}   // namespace
+
+void BenchmarkReport::open(const QString &path)
+{
+    close();
+    reportFile = new QFile(path);
+    if (!reportFile->open(QIODevice::WriteOnly | QIODevice::Truncate |
+                          QIODevice::Text))
+    {
+        qWarning("Cannot write benchmark report %s", qPrintable(path));
+        delete reportFile;
+        reportFile = 0;
+        return;
+    }
+    QTextStream(reportFile) << "benchmark,row,variant,metric,value\n";
+}
+
+void BenchmarkReport::add(const char *metric, qreal value, const char *variant)
+{
+    if (variant)
+        qDebug("%s %s: %.4f", variant, metric, value);
+    else
+        qDebug("%s: %.4f", metric, value);
+    if (!reportFile)
+        return;
+    QTextStream(reportFile) << field(QTest::currentTestFunction()) << ','
+                            << field(QTest::currentDataTag()) << ','
+                            << field(variant) << ',' << metric << ','
+                            << QString::number(value, 'g', 8) << '\n';
+}
+
+bool BenchmarkReport::close()
+{
+    if (!reportFile)
+        return true;
+    bool ok = reportFile->flush();
+    delete reportFile;
+    reportFile = 0;
+    return ok;
+}
+
+BenchmarkReport::Measurement::Measurement(int items, const char *variant) :
+    items(items), variant(variant), runs(-1)
+{
+}
+
+bool BenchmarkReport::Measurement::next()
+{
+    // The first run only warms up.
+    if (runs < 0)
+    {
+        runs = 0;
+        return true;
+    }
+    if (runs == 0)
+    {
+        AllocationCounter::start();
+        timer.start();
+    }
+    else if (timer.elapsed() >= MinimumTime || runs >= MaximumRuns)
+    {
+        finish();
+        return false;
+    }
+    runs++;
+    return true;
+}
+
+void BenchmarkReport::Measurement::finish()
+{
+    qint64 nanoseconds = timer.nsecsElapsed();
+    quint64 allocations = AllocationCounter::stop();
+    add("nsPerItem", qreal(nanoseconds) / runs / qMax(items, 1), variant);
+    if (AllocationCounter::isSupported())
+    {
+        add("allocationsPerRun", qreal(allocations) / runs, variant);
+        add("peakBytes", AllocationCounter::peakBytes(), variant);
+    }
+}
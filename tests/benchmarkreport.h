@@ -0,0 +1,49 @@
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+// Collects measurements QBENCHMARK does not report (time per item, where an
+// item is a token or a settings key, allocations per run, and peak heap
+// memory), and writes them as CSV with one "benchmark,row,variant,metric,value"
+// line each, so that results of different builds can be compared with any
+// tool. Run qclibenchmark with "-report <file>" to get one.
+namespace BenchmarkReport
+{
+
+void open(const QString &path);
+void add(const char *metric, qreal value, const char *variant = 0);
+bool close();
+
+// Measures the loop body of MEASURE: runs it once to warm up, then as often
+// as fits into a short time, and adds the averages to the report under the
+// current test function and data row. Benchmarks measuring more than one
+// thing tell them apart with MEASURE_VARIANT.
+class Measurement
+{
+public:
+    explicit Measurement(int items, const char *variant = 0);
+
+    bool next();
+
+private:
+    void finish();
+
+    int items;
+    const char *variant;
+    int runs;
+    QElapsedTimer timer;
+};
+
+}   // namespace BenchmarkReport
+
+#define MEASURE(items) \
+    for (BenchmarkReport::Measurement measurement(items); \
+         measurement.next(); )
+
+#define MEASURE_VARIANT(variant, items) \
+    for (BenchmarkReport::Measurement measurement(items, variant); \
+         measurement.next(); )
+
+#endif // BENCHMARKREPORT_H
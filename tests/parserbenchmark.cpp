@@ -0,0 +1,687 @@
+#include "parserbenchmark.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include "allocationcounter.h"
+#include "benchmarkreport.h"
+
+namespace
+{
+
+void ignore(CommandLineParser *, CommandLineParser::ParsingResult,
+            const QString &, QVariant, bool *)
+{
+}
+
+int parsedCount = 0;
+int valueCount = 0;
+
+void count(CommandLineParser *, CommandLineParser::ParsingResult,
+           const QString &, QVariant, bool *)
+{
+    parsedCount++;
+}
+
+// Counts the values handed over as strings. The callback takes a QString,
+// so each of them may cost one allocation.
+void countValues(CommandLineParser *, CommandLineParser::ParsingResult,
+                 const QString &, QVariant value, bool *)
+{
+    if (value.type() == QVariant::String && !value.toString().isEmpty())
+        valueCount++;
+}
+
+QStringList callbackArguments()
+{
+    QStringList args = ARGS;
+    for (int i = 0; i < 1000; i++)
+        args << "--verbose" << "--jobs=4" << "foo";
+    args << "--" << "bar";
+    return args;
+}
+
+// Keeps the token bytes alive and exposes them as a C-style argv.
+class Argv
+{
+public:
+    Argv(const QList<QByteArray> &tokens) : tokens(tokens)
+    {
+        pointers.append(const_cast<char *>("_cmd"));
+        for (int i = 0; i < this->tokens.size(); i++)
+            pointers.append(const_cast<char *>(this->tokens.at(i).constData()));
+    }
+
+    int argc() { return pointers.size(); }
+    char **argv() { return pointers.data(); }
+
+private:
+    QList<QByteArray> tokens;
+    QVector<char *> pointers;
+};
+
+QList<QByteArray> repeat(const QList<QByteArray> &pattern, int count)
+{
+    QList<QByteArray> tokens;
+    for (int i = 0; i < count; i++)
+        tokens.append(pattern.at(i % pattern.size()));
+    return tokens;
+}
+
+void addTokenCounts()
+{
+    QTest::addColumn<int>("tokenCount");
+    QTest::newRow("10") << 10;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("100000") << 100000;
+    QTest::newRow("1000000") << 1000000;
+}
+
+void addOptionCounts()
+{
+    QTest::addColumn<int>("optionCount");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+// Switches (with their --no- forms), and options with required and optional
+// values in turn, all in one group.
+void addMixedOptions(CommandLineParser *parser, int count)
+{
+    static const int kinds[] = {
+        OptionSwitch | OptionNegativeSwitch, OptionValueRequired,
+        OptionValueOptional
+    };
+    parser->beginOptionGroup("build");
+    for (int i = 0; i < count; i++)
+        parser->addOption(QString("option-%1").arg(i), QChar(),
+                          OptionFlags(kinds[i % 3]));
+    parser->endOptionGroup();
+}
+
+// Uses the options in a scattered order, each in every form it has, after
+// selecting their group.
+QList<QByteArray> mixedTokens(int optionCount, int tokenCount)
+{
+    QList<QByteArray> tokens;
+    tokens.append("build");
+    for (int i = 0; tokens.size() < tokenCount; i++)
+    {
+        int option = int((quint64(i) * 7919) % optionCount);
+        QByteArray number = QByteArray::number(option);
+        QByteArray name = QByteArray("--option-") + number;
+        switch (option % 3)
+        {
+        case 0:
+            tokens.append(i % 2 ? name : QByteArray("--no-option-") + number);
+            break;
+        case 1:
+            tokens.append(name);
+            tokens.append("value");
+            break;
+        default:
+            tokens.append(i % 2 ? name : name + "=value");
+            break;
+        }
+    }
+    while (tokens.size() > tokenCount)
+        tokens.removeLast();
+    return tokens;
+}
+
+void addThreadCounts()
+{
+    QTest::addColumn<int>("threads");
+    int ideal = qMax(QThread::idealThreadCount(), 1);
+    for (int threads = 1; threads < ideal; threads *= 2)
+        QTest::newRow(qPrintable(QString::number(threads))) << threads;
+    QTest::newRow(qPrintable(QString::number(ideal))) << ideal;
+}
+
+// Options of one subcommand of a large tool. Subcommands share a parser, so
+// their options are prefixed by the subcommand to keep them apart.
+void addSubcommandOptions(CommandLineParser *parser, const QString &path)
+{
+    for (int i = 0; i < 20; i++)
+        parser->addOption(QString("%1-option-%2").arg(path).arg(i), QChar(),
+                          OptionValueOptional);
+}
+
+// Parses once to warm up, then counts allocations of a second parse, less
+// the one string each value handed to the callback may cost.
+qreal allocationsPerToken(CommandLineParser *parser, Argv &args)
+{
+    parser->parse(args.argc(), args.argv(), &countValues);
+    valueCount = 0;
+    AllocationCounter::start();
+    parser->parse(args.argc(), args.argv(), &countValues);
+    quint64 allocations = AllocationCounter::stop();
+    int tokens = args.argc() - 1;
+    qDebug("Allocations per token: %.4f (%.4f values per token)",
+           qreal(allocations) / tokens, qreal(valueCount) / tokens);
+    allocations -= qMin(allocations, quint64(valueCount));
+    return qreal(allocations) / tokens;
+}
+
+// Nothing but the values should be allocated per token (only a fixed
+// amount per parse), whatever kind of token is parsed.
+void verifyAllocations(CommandLineParser *parser, Argv &args, int tokenCount)
+{
+    if (!AllocationCounter::isSupported())
+        return;
+    qreal perToken = allocationsPerToken(parser, args);
+    if (tokenCount >= 100000)
+        QVERIFY(perToken < 0.001);
+}
+
+}   // namespace
+
+void ParserBenchmark::addOptions()
+{
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("color", 'c', OptionValueOptional);
+}
+
+void ParserBenchmark::argvSwitches_data()
+{
+    addTokenCounts();
+}
+
+void ParserBenchmark::argvSwitches()
+{
+    QFETCH(int, tokenCount);
+    addOptions();
+    Argv args(repeat(QList<QByteArray>() << "--verbose" << "-v"
+                                         << "--no-verbose", tokenCount));
+
+    // Switches never carry a string value.
+    verifyAllocations(parser, args, tokenCount);
+
+    QBENCHMARK {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::argvKnownOptions_data()
+{
+    addTokenCounts();
+}
+
+void ParserBenchmark::argvKnownOptions()
+{
+    QFETCH(int, tokenCount);
+    addOptions();
+    Argv args(repeat(QList<QByteArray>() << "--jobs=4" << "--color"
+                                         << "-j" << "8", tokenCount));
+
+    // Only the values handed to the callback are materialized.
+    verifyAllocations(parser, args, tokenCount);
+
+    QBENCHMARK {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::argvLongOptions_data()
+{
+    addTokenCounts();
+}
+
+void ParserBenchmark::argvLongOptions()
+{
+    QFETCH(int, tokenCount);
+    addOptions();
+    parser->addOption("output-directory", 'o', OptionValueRequired);
+    Argv args(repeat(QList<QByteArray>()
+                     << "--output-directory=/usr/local/share/applications"
+                     << "--output-directory" << "/var/tmp/some/build/dir"
+                     << "--color=always-and-everywhere", tokenCount));
+    verifyAllocations(parser, args, tokenCount);
+
+    QBENCHMARK {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::argvMixedOptions_data()
+{
+    addTokenCounts();
+}
+
+void ParserBenchmark::argvMixedOptions()
+{
+    QFETCH(int, tokenCount);
+    addMixedOptions(parser, 30);
+    Argv args(mixedTokens(30, tokenCount));
+    verifyAllocations(parser, args, tokenCount);
+
+    QBENCHMARK {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::optionCount_data()
+{
+    addOptionCounts();
+}
+
+void ParserBenchmark::optionCount()
+{
+    QFETCH(int, optionCount);
+    addMixedOptions(parser, optionCount);
+    parser->freeze();
+    int tokenCount = 100000;
+    Argv args(mixedTokens(optionCount, tokenCount));
+
+    QBENCHMARK {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::registration_data()
+{
+    addOptionCounts();
+}
+
+// Registers the options and compiles the plan, as every process of a tool
+// does once at startup. With "-report", the peak heap memory of a run is
+// about what the parser keeps resident for the options.
+void ParserBenchmark::registration()
+{
+    QFETCH(int, optionCount);
+
+    QBENCHMARK {
+        CommandLineParser registered;
+        addMixedOptions(&registered, optionCount);
+        registered.freeze();
+    }
+    MEASURE(optionCount) {
+        CommandLineParser registered;
+        addMixedOptions(&registered, optionCount);
+        registered.freeze();
+    }
+}
+
+void ParserBenchmark::stringListSwitches_data()
+{
+    addTokenCounts();
+}
+
+void ParserBenchmark::stringListSwitches()
+{
+    QFETCH(int, tokenCount);
+    addOptions();
+    QStringList args = ARGS;
+    QList<QByteArray> tokens = repeat(
+                QList<QByteArray>() << "--verbose" << "-v" << "--no-verbose",
+                tokenCount);
+    foreach (const QByteArray &token, tokens)
+        args << QString::fromLatin1(token);
+
+    QBENCHMARK {
+        parser->parse(args, &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args, &ignore);
+    }
+}
+
+void ParserBenchmark::onParsed(
+        CommandLineParser *, CommandLineParser::ParsingResult,
+        const QString &, QVariant, bool *)
+{
+    parsedCount++;
+}
+
+void ParserBenchmark::onParsedSlot(
+        CommandLineParser *, CommandLineParser::ParsingResult,
+        const QString &, QVariant, bool *)
+{
+    parsedCount++;
+}
+
+// The callback benchmarks all parse the same input, and differ only in how
+// the callback is dispatched.
+
+void ParserBenchmark::callbackFunctionPointer()
+{
+    addOptions();
+    QStringList args = callbackArguments();
+    parsedCount = 0;
+    QBENCHMARK {
+        parser->parse(args, &count);
+    }
+    MEASURE(args.size() - 1) {
+        parser->parse(args, &count);
+    }
+    QVERIFY(parsedCount > 0);
+}
+
+void ParserBenchmark::callbackSlotName()
+{
+    addOptions();
+    QStringList args = callbackArguments();
+    parsedCount = 0;
+    QBENCHMARK {
+        parser->parse(args, this, "onParsedSlot");
+    }
+    MEASURE(args.size() - 1) {
+        parser->parse(args, this, "onParsedSlot");
+    }
+    QVERIFY(parsedCount > 0);
+}
+
+void ParserBenchmark::callbackMemberPointer()
+{
+    addOptions();
+    QStringList args = callbackArguments();
+    parsedCount = 0;
+    QBENCHMARK {
+        parser->parse(args, this, &ParserBenchmark::onParsed);
+    }
+    MEASURE(args.size() - 1) {
+        parser->parse(args, this, &ParserBenchmark::onParsed);
+    }
+    QVERIFY(parsedCount > 0);
+}
+
+void ParserBenchmark::callbackLambda()
+{
+#ifdef Q_COMPILER_LAMBDA
+    addOptions();
+    QStringList args = callbackArguments();
+    int count = 0;
+    QBENCHMARK {
+        parser->parse(args, [&count](
+                CommandLineParser *, CommandLineParser::ParsingResult,
+                const QString &, QVariant, bool *) {
+            count++;
+        });
+    }
+    QVERIFY(count > 0);
+#endif
+}
+
+void ParserBenchmark::parallelScaling_data()
+{
+    addThreadCounts();
+}
+
+void ParserBenchmark::parallelScaling()
+{
+    QFETCH(int, threads);
+    addOptions();
+    parser->addOption("very-long-option-name-to-look-up", QChar(),
+                      OptionSwitch);
+    parser->setAbbreviationsEnabled(true);
+    parser->setParsingThreadCount(threads);
+    int tokenCount = 500000;
+    Argv args(repeat(QList<QByteArray>() << "--verbose" << "-j" << "8"
+                                         << "--very-long-option-name-to-look-up"
+                                         << "--very-long" << "--jobs=4",
+                     tokenCount));
+
+    QBENCHMARK {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE(tokenCount) {
+        parser->parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::commandStrings_data()
+{
+    QTest::addColumn<QString>("command");
+    QTest::newRow("plain") << "run --verbose --jobs=4 -c build.log input.txt";
+    QTest::newRow("quoted") << "run --verbose --jobs \"4\" -c 'build log' "
+                               "my\\ input.txt";
+}
+
+void ParserBenchmark::commandStrings()
+{
+    QFETCH(QString, command);
+    addOptions();
+    parser->freeze();
+
+    // Each command is split and parsed on its own, as a daemon would.
+    QStringList commands;
+    for (int i = 0; i < 1000; i++)
+        commands << command + QString(" %1").arg(i);
+
+    QBENCHMARK {
+        foreach (const QString &c, commands)
+            parser->parseCommand(c, &ignore);
+    }
+    MEASURE(commands.size()) {
+        foreach (const QString &c, commands)
+            parser->parseCommand(c, &ignore);
+    }
+
+    // At least a hundred thousand commands per second on one core, which
+    // only holds in optimized builds.
+    QElapsedTimer timer;
+    timer.start();
+    int rounds = 0;
+    do
+    {
+        foreach (const QString &c, commands)
+            parser->parseCommand(c, &ignore);
+        rounds++;
+    } while (timer.elapsed() < 200);
+    qreal perSecond = rounds * commands.size() * 1000.0 / timer.elapsed();
+    qDebug("Commands per second: %.0f", perSecond);
+#ifdef QT_NO_DEBUG
+    QVERIFY(perSecond >= 100000);
+#endif
+}
+
+void ParserBenchmark::subcommandStartup_data()
+{
+    QTest::addColumn<int>("subcommandCount");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+// Sets up a parser for a tool with many subcommands and parses one short
+// command line, as a process of that tool does once. Registering every
+// subcommand's options up front costs more the more subcommands there are;
+// registering them lazily should not.
+void ParserBenchmark::subcommandStartup()
+{
+    QFETCH(int, subcommandCount);
+    QList<QByteArray> tokens;
+    tokens << "sub-3" << "--sub-3-option-1" << "value" << "--sub-3-option-2"
+           << "file";
+    Argv args(tokens);
+
+    MEASURE_VARIANT("eager", 1) {
+        CommandLineParser eager;
+        for (int i = 0; i < subcommandCount; i++)
+        {
+            QString name = QString("sub-%1").arg(i);
+            eager.beginOptionGroup(name);
+            addSubcommandOptions(&eager, name);
+            eager.endOptionGroup();
+        }
+        eager.parse(args.argc(), args.argv(), &ignore);
+    }
+    MEASURE_VARIANT("lazy", 1) {
+        CommandLineParser lazy;
+        for (int i = 0; i < subcommandCount; i++)
+            lazy.addSubcommand(QString("sub-%1").arg(i),
+                               &addSubcommandOptions);
+        lazy.parse(args.argc(), args.argv(), &ignore);
+    }
+}
+
+void ParserBenchmark::completion_data()
+{
+    QTest::addColumn<int>("optionCount");
+    QTest::addColumn<int>("subcommandCount");
+    QTest::newRow("100") << 100 << 0;
+    QTest::newRow("1000") << 1000 << 0;
+    QTest::newRow("10000") << 10000 << 0;
+    QTest::newRow("1000 subcommands") << 0 << 1000;
+    QTest::newRow("10000 subcommands") << 0 << 10000;
+}
+
+namespace
+{
+
+int loadedSubcommandCount = 0;
+
+void addCountedSubcommandOptions(CommandLineParser *parser,
+                                 const QString &path)
+{
+    loadedSubcommandCount++;
+    addSubcommandOptions(parser, path);
+}
+
+}   // namespace
+
+// Completes a partial option name, as a shell does on each tab press. The
+// shell waits for the answer, so it has to come quickly even for tools with
+// very many options or subcommands. Of lazily registered subcommands, only
+// those on the command line may be loaded.
+void ParserBenchmark::completion()
+{
+    QFETCH(int, optionCount);
+    QFETCH(int, subcommandCount);
+    QStringList words;
+    if (subcommandCount)
+    {
+        loadedSubcommandCount = 0;
+        for (int i = 0; i < subcommandCount; i++)
+            parser->addSubcommand(QString("sub-%1").arg(i),
+                                  &addCountedSubcommandOptions);
+        words << "tool" << "sub-7" << "--sub-7-option-1";
+        QCOMPARE(parser->complete(words).size(), 11);
+        QCOMPARE(loadedSubcommandCount, 1);
+    }
+    else
+    {
+        addMixedOptions(parser, optionCount);
+        parser->freeze();
+        words << "tool" << "build" << "--option-1";
+    }
+
+    QBENCHMARK {
+        parser->complete(words);
+    }
+    MEASURE(1) {
+        parser->complete(words);
+    }
+
+    // Well under a millisecond per completion, which only holds in optimized
+    // builds.
+    QElapsedTimer timer;
+    timer.start();
+    int rounds = 0;
+    do
+    {
+        parser->complete(words);
+        rounds++;
+    } while (timer.elapsed() < 200);
+    qreal perCall = timer.elapsed() / qreal(rounds);
+    qDebug("Milliseconds per completion: %.3f", perCall);
+#ifdef QT_NO_DEBUG
+    QVERIFY(perCall < 1);
+#endif
+}
+
+void ParserBenchmark::reusedResult_data()
+{
+    QTest::addColumn<int>("tokenCount");
+    QTest::newRow("10") << 10;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("100000") << 100000;
+}
+
+// Parses the same kind of command line over and over, as a dispatcher does,
+// into a new result each time and into one result kept from the last parse.
+void ParserBenchmark::reusedResult()
+{
+    QFETCH(int, tokenCount);
+    addMixedOptions(parser, 30);
+    parser->freeze();
+    Argv args(mixedTokens(30, tokenCount));
+    ParseResult result;
+
+    QBENCHMARK {
+        parser->parseAll(args.argc(), args.argv(), &result);
+    }
+    MEASURE_VARIANT("new", tokenCount) {
+        parser->parseAll(args.argc(), args.argv());
+    }
+    MEASURE_VARIANT("reused", tokenCount) {
+        parser->parseAll(args.argc(), args.argv(), &result);
+    }
+
+    // Once the result has grown to fit, parsing into it allocates nothing.
+    if (AllocationCounter::isSupported())
+    {
+        AllocationCounter::start();
+        for (int i = 0; i < 100; i++)
+            parser->parseAll(args.argc(), args.argv(), &result);
+        QCOMPARE(AllocationCounter::stop(), quint64(0));
+    }
+}
+
+void ParserBenchmark::environment_data()
+{
+    QTest::addColumn<int>("optionCount");
+    QTest::newRow("10") << 10;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+// Reads options from the environment: in one pass over it, or by asking for
+// each option's variable and building arguments from what is set, as
+// callers had to before.
+void ParserBenchmark::environment()
+{
+    QFETCH(int, optionCount);
+    addMixedOptions(parser, optionCount);
+    parser->setEnvironmentPrefix("QCLIBENCH_");
+    parser->freeze();
+    for (int i = 0; i < 10; i++)
+        qputenv(QByteArray("QCLIBENCH_OPTION_") + QByteArray::number(i), "1");
+    QStringList args = ARGS;
+
+    QBENCHMARK {
+        parser->parse(args, &ignore);
+    }
+    MEASURE_VARIANT("scan", optionCount) {
+        parser->parse(args, &ignore);
+    }
+    MEASURE_VARIANT("getenv", optionCount) {
+        QStringList expanded = args;
+        for (int i = 0; i < optionCount; i++)
+        {
+            QByteArray value = qgetenv(
+                        (QByteArray("QCLIBENCH_OPTION_") +
+                         QByteArray::number(i)).constData());
+            if (!value.isNull())
+                expanded << QString("--option-%1=%2").arg(i).arg(
+                                QString::fromLocal8Bit(value));
+        }
+        parser->parse(expanded, &ignore);
+    }
+}
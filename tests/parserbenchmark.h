@@ -0,0 +1,59 @@
+#ifndef PARSERBENCHMARK_H
+#define PARSERBENCHMARK_H
+
+#include "qclitest.h"
+
+class ParserBenchmark : public QCliTest
+{
+    Q_OBJECT
+
+    void addOptions();
+
+public:
+    void onParsed(CommandLineParser *parser,
+                  CommandLineParser::ParsingResult result,
+                  const QString &name, QVariant value, bool *stop);
+
+public slots:
+    void onParsedSlot(CommandLineParser *parser,
+                      CommandLineParser::ParsingResult result,
+                      const QString &name, QVariant value, bool *stop);
+
+private slots:
+    void argvSwitches_data();
+    void argvSwitches();
+    void argvKnownOptions_data();
+    void argvKnownOptions();
+    void argvLongOptions_data();
+    void argvLongOptions();
+    void argvMixedOptions_data();
+    void argvMixedOptions();
+    void optionCount_data();
+    void optionCount();
+    void registration_data();
+    void registration();
+    void stringListSwitches_data();
+    void stringListSwitches();
+    void callbackFunctionPointer();
+    void callbackSlotName();
+    void callbackMemberPointer();
+    void callbackLambda();
+    void parallelScaling_data();
+    void parallelScaling();
+    void commandStrings_data();
+    void commandStrings();
+    void subcommandStartup_data();
+    void subcommandStartup();
+    void completion_data();
+    void completion();
+    void reusedResult_data();
+    void reusedResult();
+    void environment_data();
+    void environment();
+
+private:
+    int parsedCount;
+};
+
+
+#endif  // PARSERBENCHMARK_H
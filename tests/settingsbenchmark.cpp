@@ -0,0 +1,174 @@
+#include "settingsbenchmark.h"
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include "benchmarkreport.h"
+
+namespace
+{
+
+void addChains()
+{
+    QTest::addColumn<int>("depth");
+    QTest::addColumn<int>("keyCount");
+    QTest::newRow("depth 1 keys 100") << 1 << 100;
+    QTest::newRow("depth 10 keys 100") << 10 << 100;
+    QTest::newRow("depth 100 keys 100") << 100 << 100;
+    QTest::newRow("depth 10 keys 10000") << 10 << 10000;
+}
+
+QString key(int i)
+{
+    return QString("key-%1").arg(i);
+}
+
+}   // namespace
+
+void SettingsBenchmark::init()
+{
+    root = 0;
+    leaf = 0;
+}
+
+void SettingsBenchmark::cleanup()
+{
+    delete root;
+    root = 0;
+    leaf = 0;
+}
+
+void SettingsBenchmark::buildChain(int depth)
+{
+    root = new Settings("root");
+    leaf = root;
+    for (int i = 1; i < depth; i++)
+        leaf = new Settings(QString("level-%1").arg(i), leaf);
+}
+
+QString SettingsBenchmark::writeIni(const QString &name, int keyCount)
+{
+    QString path = QDir::temp().filePath(name);
+    QFile::remove(path);
+    QFile::remove(path + ".qclisnapshot");
+    QSettings ini(path, QSettings::IniFormat);
+    for (int i = 0; i < keyCount; i++)
+        ini.setValue(key(i), i % 2 ? QVariant(i) : QVariant(key(i)));
+    ini.sync();
+    return path;
+}
+
+void SettingsBenchmark::value_data()
+{
+    addChains();
+}
+
+// Values are all set on the root, and looked up from the far end of the
+// chain: once resolved, and while they keep changing.
+void SettingsBenchmark::value()
+{
+    QFETCH(int, depth);
+    QFETCH(int, keyCount);
+    buildChain(depth);
+    QStringList keys;
+    for (int i = 0; i < keyCount; i++)
+    {
+        keys.append(key(i));
+        root->setValue(keys.last(), i);
+    }
+
+    QBENCHMARK {
+        foreach (const QString &k, keys)
+            leaf->value(k);
+    }
+    MEASURE_VARIANT("resolved", keyCount) {
+        foreach (const QString &k, keys)
+            leaf->value(k);
+    }
+
+    // Callers keeping key ids skip hashing the keys.
+    QList<Settings::KeyId> ids;
+    foreach (const QString &k, keys)
+        ids.append(leaf->keyId(k));
+    MEASURE_VARIANT("resolved by id", keyCount) {
+        foreach (Settings::KeyId id, ids)
+            leaf->value(id);
+    }
+
+    int n = 0;
+    MEASURE_VARIANT("changing", keyCount) {
+        foreach (const QString &k, keys)
+        {
+            root->setValue(k, n++);
+            leaf->value(k);
+        }
+    }
+}
+
+void SettingsBenchmark::load_data()
+{
+    addChains();
+}
+
+// Loads into the far end of the chain, with and without the snapshot.
+void SettingsBenchmark::load()
+{
+    QFETCH(int, depth);
+    QFETCH(int, keyCount);
+    buildChain(depth);
+    QString path = writeIni("qcli-benchmark-load.ini", keyCount);
+    QSettings ini(path, QSettings::IniFormat);
+
+    leaf->setSnapshotEnabled(false);
+    QBENCHMARK {
+        leaf->load(&ini);
+    }
+    MEASURE_VARIANT("qsettings", keyCount) {
+        leaf->load(&ini);
+    }
+
+    leaf->setSnapshotEnabled(true);
+    leaf->load(&ini);
+    QVERIFY(QFile::exists(path + ".qclisnapshot"));
+    MEASURE_VARIANT("snapshot", keyCount) {
+        leaf->load(&ini);
+    }
+}
+
+void SettingsBenchmark::save_data()
+{
+    addChains();
+}
+
+// Saves every key (alternating between two files, so that nothing counts as
+// saved already), and then only the key changed since the last save.
+void SettingsBenchmark::save()
+{
+    QFETCH(int, depth);
+    QFETCH(int, keyCount);
+    buildChain(depth);
+    QString path = writeIni("qcli-benchmark-save.ini", keyCount);
+    QString otherPath = writeIni("qcli-benchmark-save2.ini", 0);
+    QSettings ini(path, QSettings::IniFormat);
+    QSettings other(otherPath, QSettings::IniFormat);
+    leaf->setSnapshotEnabled(false);
+    leaf->load(&ini);
+
+    bool toOther = false;
+    QBENCHMARK {
+        leaf->save(toOther ? &other : &ini);
+        toOther = !toOther;
+    }
+    MEASURE_VARIANT("all", keyCount) {
+        leaf->save(toOther ? &other : &ini);
+        toOther = !toOther;
+    }
+
+    leaf->save(&ini);
+    int n = 0;
+    MEASURE_VARIANT("changed", 1) {
+        leaf->setValue(key(n % keyCount), n);
+        n++;
+        leaf->save(&ini);
+    }
+    QCOMPARE(leaf->lastSaveStatistics().keysWritten, 1);
+}
@@ -0,0 +1,32 @@
+#ifndef SETTINGSBENCHMARK_H
+#define SETTINGSBENCHMARK_H
+
+#include <QtTest>
+#include <qcli.h>
+
+using namespace QCli;
+
+class SettingsBenchmark : public QObject
+{
+    Q_OBJECT
+
+    void buildChain(int depth);
+    QString writeIni(const QString &name, int keyCount);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void value_data();
+    void value();
+    void load_data();
+    void load();
+    void save_data();
+    void save();
+
+private:
+    Settings *root;
+    Settings *leaf;
+};
+
+#endif // SETTINGSBENCHMARK_H
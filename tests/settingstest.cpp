@@ -0,0 +1,465 @@
+#include "settingstest.h"
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QThread>
+
+void SettingsTest::init()
+{
+    root = new Settings("root", this);
+    child = new Settings("child", root);
+    grandchild = new Settings("grandchild", child);
+}
+
+void SettingsTest::cleanup()
+{
+    delete root;
+    root = 0;
+    child = 0;
+    grandchild = 0;
+}
+
+void SettingsTest::testParentChain()
+{
+    QCOMPARE(grandchild->name(), QString("grandchild"));
+    QCOMPARE(grandchild->parentSettings(), child);
+    QVERIFY(!grandchild->value("foo").isValid());
+
+    // Values are inherited, and the cached lookups follow changes made to
+    // any ancestor.
+    root->setValue("foo", 1);
+    QCOMPARE(grandchild->value("foo"), QVariant(1));
+    root->setValue("foo", 2);
+    QCOMPARE(grandchild->value("foo"), QVariant(2));
+    QCOMPARE(child->value("foo"), QVariant(2));
+
+    // Nearer values shadow farther ones.
+    child->setLocalValue("foo", 3);
+    QCOMPARE(grandchild->value("foo"), QVariant(3));
+    QCOMPARE(root->value("foo"), QVariant(2));
+    QCOMPARE(grandchild->settings("foo"), child);
+    QVERIFY(!grandchild->settings("bar"));
+
+    // Deleting a node in the middle of the chain is fine.
+    delete child;
+    child = 0;
+    QCOMPARE(root->value("foo"), QVariant(2));
+}
+
+void SettingsTest::testStatistics()
+{
+    if (!CommandLineParser::statisticsEnabled())
+        return;
+
+    root->setValue("foo", 1);
+    grandchild->value("foo");
+    grandchild->value("foo");
+    Settings::Statistics statistics = grandchild->statistics();
+    QCOMPARE(statistics.lookups, quint64(2));
+    QCOMPARE(statistics.cacheHits, quint64(1));
+    QCOMPARE(statistics.parentHops, quint64(2));
+
+    grandchild->resetStatistics();
+    QCOMPARE(grandchild->statistics().lookups, quint64(0));
+}
+
+namespace
+{
+
+// Reads the values of a few keys, each from a cold cache in turn.
+class ReadThread : public QThread
+{
+public:
+    ReadThread(Settings *settings, const QList<Settings::KeyId> &keys) :
+        settings(settings), keys(keys), failures(0) {}
+
+    void run()
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            int k = i % keys.size();
+            if (settings->value(keys.at(k)) != QVariant(k))
+                failures++;
+        }
+    }
+
+    Settings *settings;
+    QList<Settings::KeyId> keys;
+    int failures;
+};
+
+}   // namespace
+
+// Meant to be run under ThreadSanitizer as well (see tests.pro).
+void SettingsTest::testConcurrentReads()
+{
+    QList<Settings::KeyId> keys;
+    for (int i = 0; i < 100; i++)
+    {
+        keys << root->keyId(QString("key-%1").arg(i));
+        root->setValue(keys.last(), i);
+    }
+
+    QList<ReadThread *> threads;
+    for (int i = 0; i < 8; i++)
+        threads << new ReadThread(i % 2 ? child : grandchild, keys);
+    for (int i = 0; i < threads.size(); i++)
+        threads.at(i)->start();
+    for (int i = 0; i < threads.size(); i++)
+    {
+        threads.at(i)->wait();
+        QCOMPARE(threads.at(i)->failures, 0);
+    }
+    qDeleteAll(threads);
+
+    if (CommandLineParser::statisticsEnabled())
+    {
+        QCOMPARE(grandchild->statistics().lookups, quint64(4 * 1000));
+        QCOMPARE(grandchild->statistics().cacheHits, quint64(4 * 1000 - 100));
+    }
+}
+
+void SettingsTest::testArrays()
+{
+    root->registerArray("list");
+    child->registerArray("list");
+    grandchild->registerArray("list");
+    root->setValue("list", 1);
+    child->setValue("list", QVariantList() << 2 << 3);
+    QCOMPARE(grandchild->value("list"),
+             QVariant(QVariantList() << 2 << 3 << 1));
+    QCOMPARE(root->value("list"), QVariant(QVariantList() << 1));
+
+    // Merged arrays are rebuilt when any part changes.
+    root->setValue("list", 4);
+    QCOMPARE(grandchild->value("list"),
+             QVariant(QVariantList() << 2 << 3 << 1 << 4));
+}
+
+void SettingsTest::testKeyIds()
+{
+    // Ids are shared by the whole tree, and work like the keys they stand
+    // for.
+    Settings::KeyId foo = grandchild->keyId("foo");
+    QVERIFY(foo.isValid());
+    QVERIFY(foo == root->keyId("foo"));
+    QVERIFY(foo != root->keyId("bar"));
+    QCOMPARE(child->keyName(foo), QString("foo"));
+    QVERIFY(!Settings::KeyId().isValid());
+
+    root->setValue(foo, 1);
+    QCOMPARE(grandchild->value(foo), QVariant(1));
+    QCOMPARE(grandchild->value("foo"), QVariant(1));
+    child->setLocalValue("foo", 2);
+    QCOMPARE(grandchild->value(foo), QVariant(2));
+    QCOMPARE(child->localValue(foo), QVariant(2));
+    child->removeLocalValue(foo);
+    QCOMPARE(grandchild->value(foo), QVariant(1));
+    QVERIFY(!grandchild->value(Settings::KeyId()).isValid());
+    QVERIFY(!grandchild->value("never-set").isValid());
+
+    // Looking up a key does not intern it.
+    QVERIFY(!child->findKeyId("never-set").isValid());
+    QVERIFY(child->findKeyId("foo") == foo);
+
+    // Invalid ids have no value, and cannot be given one.
+    child->setValue(Settings::KeyId(), 5);
+    child->setLocalValue(Settings::KeyId(), 6);
+    QVERIFY(!child->localValue(Settings::KeyId()).isValid());
+    QCOMPARE(child->localValue(foo), QVariant());
+    QCOMPARE(grandchild->value(foo), QVariant(1));
+
+    // Settings in another tree have their own ids.
+    Settings other("other");
+    other.setValue("bar", 3);
+    other.setValue("foo", 4);
+    QCOMPARE(other.value(other.keyId("foo")), QVariant(4));
+    QVERIFY(!root->value("bar").isValid());
+}
+
+void SettingsTest::testSnapshot()
+{
+    QString path = QDir::temp().filePath("qcli-settingstest.ini");
+    QString snapshot = path + ".qclisnapshot";
+    QFile::remove(path);
+    QFile::remove(snapshot);
+    {
+        QSettings ini(path, QSettings::IniFormat);
+        ini.setValue("--name", "foo");
+        ini.setValue("count", 3);
+        ini.setValue("list", QStringList() << "a" << "b");
+        ini.sync();
+    }
+
+    // Snapshots are only taken if asked for.
+    QSettings ini(path, QSettings::IniFormat);
+    root->load(&ini);
+    QVERIFY(!QFile::exists(snapshot));
+    root->setSnapshotEnabled(true);
+    child->setSnapshotEnabled(true);
+    grandchild->setSnapshotEnabled(true);
+    root->load(&ini);
+    QVERIFY(QFile::exists(snapshot));
+    QCOMPARE(root->value("name"), QVariant("foo"));
+
+    // The snapshot gives the same values as the file.
+    child->load(&ini);
+    QCOMPARE(child->localValue("name"), root->localValue("name"));
+    QCOMPARE(child->localValue("count"), root->localValue("count"));
+    QCOMPARE(child->localValue("list"), root->localValue("list"));
+    QCOMPARE(child->localValue("list").toStringList(),
+             QStringList() << "a" << "b");
+
+#if QT_VERSION >= 0x050a00
+    // Edits that keep the size and the modification time make it stale,
+    // too.
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QDateTime modified = file.fileTime(QFileDevice::FileModificationTime);
+        QByteArray contents = file.readAll();
+        contents.replace("count=3", "count=4");
+        QVERIFY(file.seek(0));
+        file.write(contents);
+        file.flush();
+        QVERIFY(file.setFileTime(modified, QFileDevice::FileModificationTime));
+    }
+    QSettings edited(path, QSettings::IniFormat);
+    grandchild->load(&edited);
+    QCOMPARE(grandchild->localValue("count").toInt(), 4);
+#endif
+
+    // Changing the file makes the snapshot stale.
+    {
+        QSettings ini(path, QSettings::IniFormat);
+        ini.setValue("count", 12345);
+        ini.sync();
+    }
+    QSettings changed(path, QSettings::IniFormat);
+    grandchild->load(&changed);
+    QCOMPARE(grandchild->localValue("count").toInt(), 12345);
+
+    // So do changes not synced yet.
+    changed.setValue("count", 54321);
+    child->load(&changed);
+    QCOMPARE(child->localValue("count").toInt(), 54321);
+
+    // Snapshots can be turned off.
+    QFile::remove(snapshot);
+    grandchild->setSnapshotEnabled(false);
+    grandchild->load(&changed);
+    QVERIFY(!QFile::exists(snapshot));
+    QCOMPARE(grandchild->localValue("count").toInt(), 54321);
+
+    QFile::remove(path);
+}
+
+// Values from fallbacks are not in the file the snapshot is checked against,
+// so settings with fallbacks have none.
+void SettingsTest::testSnapshotFallbacks()
+{
+    QString userPath = QDir::temp().filePath("qcli-settingstest-user");
+    QString systemPath = QDir::temp().filePath("qcli-settingstest-system");
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, userPath);
+    QSettings::setPath(QSettings::IniFormat, QSettings::SystemScope,
+                       systemPath);
+    QSettings organization(QSettings::IniFormat, QSettings::UserScope,
+                           "qcli-settingstest");
+    QSettings application(QSettings::IniFormat, QSettings::UserScope,
+                          "qcli-settingstest", "application");
+    organization.clear();
+    organization.setValue("shared", 1);
+    organization.sync();
+    application.clear();
+    application.setValue("own", 2);
+    application.sync();
+    QString snapshot = application.fileName() + ".qclisnapshot";
+    QFile::remove(snapshot);
+
+    root->setSnapshotEnabled(true);
+    root->load(&application);
+    QVERIFY(!QFile::exists(snapshot));
+    QCOMPARE(root->localValue("shared"), QVariant(1));
+    QCOMPARE(root->localValue("own"), QVariant(2));
+
+    // Only the fallback changed.
+    organization.setValue("shared", 3);
+    organization.sync();
+    application.sync();
+    root->load(&application);
+    QCOMPARE(root->localValue("shared"), QVariant(3));
+
+    // Without fallbacks, the file is all there is.
+    application.setFallbacksEnabled(false);
+    root->load(&application);
+    QVERIFY(QFile::exists(snapshot));
+    QVERIFY(!root->localValue("shared").isValid());
+    QCOMPARE(root->localValue("own"), QVariant(2));
+
+    QFile::remove(snapshot);
+    organization.clear();
+    organization.sync();
+    application.clear();
+    application.sync();
+}
+
+void SettingsTest::testIncrementalSave()
+{
+    QString path = QDir::temp().filePath("qcli-savetest.ini");
+    QFile::remove(path);
+    root->setSnapshotEnabled(false);
+    {
+        QSettings ini(path, QSettings::IniFormat);
+        for (int i = 0; i < 100; i++)
+            ini.setValue(QString("key%1").arg(i), i);
+        ini.sync();
+    }
+
+    QSettings ini(path, QSettings::IniFormat);
+    root->load(&ini);
+
+    // Nothing changed, nothing written.
+    root->save(&ini);
+    QCOMPARE(root->lastSaveStatistics().keysWritten, 0);
+    QCOMPARE(root->lastSaveStatistics().keysRemoved, 0);
+
+    root->setValue("key1", "changed");
+    root->removeLocalValue("key2");
+    root->save(&ini);
+    QCOMPARE(root->lastSaveStatistics().keysWritten, 1);
+    QCOMPARE(root->lastSaveStatistics().keysRemoved, 1);
+    QCOMPARE(ini.value("key1").toString(), QString("changed"));
+    QVERIFY(!ini.contains("key2"));
+
+    root->save(&ini);
+    QCOMPARE(root->lastSaveStatistics().keysWritten, 0);
+
+    // Another file gets everything.
+    QString otherPath = QDir::temp().filePath("qcli-savetest2.ini");
+    QFile::remove(otherPath);
+    QSettings other(otherPath, QSettings::IniFormat);
+    root->save(&other);
+    QCOMPARE(root->lastSaveStatistics().keysWritten, 99);
+    QCOMPARE(other.value("key1").toString(), QString("changed"));
+
+    QFile::remove(path);
+    QFile::remove(otherPath);
+}
+
+void SettingsTest::recordNetwork(const QStringList &keys)
+{
+    QStringList sorted = keys;
+    sorted.sort();
+    networkChanges.append(sorted);
+}
+
+void SettingsTest::testWatch()
+{
+    QString path = QDir::temp().filePath("qcli-watchtest.ini");
+    QFile::remove(path);
+    {
+        QSettings ini(path, QSettings::IniFormat);
+        ini.setValue("name", "file");
+        ini.setValue("count", 3);
+        ini.setValue("net/host", "localhost");
+        ini.setValue("net/port", 80);
+        ini.setValue("unchanged", "same");
+        ini.sync();
+    }
+
+    QSettings ini(path, QSettings::IniFormat);
+    root->setSnapshotEnabled(false);
+    root->setReloadDelay(0);
+    root->watch(&ini);
+    QVERIFY(root->isWatching());
+    QCOMPARE(root->value("count").toInt(), 3);
+
+    // Set here, e.g. from the command line; a reload leaves it alone.
+    root->setValue("name", "local");
+
+    networkChanges.clear();
+    root->subscribe("net/", this, "recordNetwork");
+    root->subscribe("other/", this, "recordNetwork");
+
+    // Overlapping filters of one subscriber still make one call, with each
+    // key once.
+    root->subscribe("net/port", this, "recordNetwork");
+    QSignalSpy spy(root, SIGNAL(changed(QStringList)));
+    {
+        QSettings ini(path, QSettings::IniFormat);
+        ini.setValue("name", "changed in file");
+        ini.setValue("count", 4);
+        ini.remove("net/host");
+        ini.setValue("net/port", 8080);
+        ini.setValue("added", true);
+        ini.sync();
+    }
+    for (int i = 0; i < 100 && spy.isEmpty(); i++)
+        QTest::qWait(50);
+
+    // One notification, with exactly the keys that changed.
+    QCOMPARE(spy.count(), 1);
+    QStringList keys = spy.at(0).at(0).toStringList();
+    keys.sort();
+    QCOMPARE(keys, QStringList() << "added" << "count" << "net/host"
+                                 << "net/port");
+    QCOMPARE(networkChanges.size(), 1);
+    QCOMPARE(networkChanges.at(0), QStringList() << "net/host" << "net/port");
+
+    QCOMPARE(root->value("count").toInt(), 4);
+    QCOMPARE(child->value("net/port").toInt(), 8080);
+    QVERIFY(!root->value("net/host").isValid());
+    QCOMPARE(root->value("name"), QVariant("local"));
+    QCOMPARE(root->value("unchanged"), QVariant("same"));
+
+    root->unsubscribe(this);
+    root->unwatch();
+    QVERIFY(!root->isWatching());
+    QFile::remove(path);
+}
+
+// Reloads keep the values taken from fallbacks.
+void SettingsTest::testWatchFallbacks()
+{
+    QString userPath = QDir::temp().filePath("qcli-watchtest-user");
+    QString systemPath = QDir::temp().filePath("qcli-watchtest-system");
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, userPath);
+    QSettings::setPath(QSettings::IniFormat, QSettings::SystemScope,
+                       systemPath);
+    QSettings organization(QSettings::IniFormat, QSettings::UserScope,
+                           "qcli-watchtest");
+    QSettings application(QSettings::IniFormat, QSettings::UserScope,
+                          "qcli-watchtest", "application");
+    organization.clear();
+    organization.setValue("shared", 1);
+    organization.sync();
+    application.clear();
+    application.setValue("own", 2);
+    application.sync();
+
+    root->setReloadDelay(0);
+    root->watch(&application);
+    QCOMPARE(root->value("shared"), QVariant(1));
+    QCOMPARE(root->value("own"), QVariant(2));
+
+    QSignalSpy spy(root, SIGNAL(changed(QStringList)));
+    {
+        QSettings application(QSettings::IniFormat, QSettings::UserScope,
+                              "qcli-watchtest", "application");
+        application.setValue("own", 3);
+        application.sync();
+    }
+    for (int i = 0; i < 100 && spy.isEmpty(); i++)
+        QTest::qWait(50);
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toStringList(), QStringList() << "own");
+    QCOMPARE(root->value("own").toInt(), 3);
+    QCOMPARE(root->value("shared").toInt(), 1);
+
+    root->unwatch();
+    organization.clear();
+    organization.sync();
+    application.clear();
+    application.sync();
+}
@@ -0,0 +1,38 @@
+#ifndef SETTINGSTEST_H
+#define SETTINGSTEST_H
+
+#include <QtTest>
+#include <qcli.h>
+
+using namespace QCli;
+
+class SettingsTest : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void recordNetwork(const QStringList &keys);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testParentChain();
+    void testStatistics();
+    void testConcurrentReads();
+    void testArrays();
+    void testKeyIds();
+    void testSnapshot();
+    void testSnapshotFallbacks();
+    void testIncrementalSave();
+    void testWatch();
+    void testWatchFallbacks();
+
+private:
+    QList<QStringList> networkChanges;
+    Settings *root;
+    Settings *child;
+    Settings *grandchild;
+};
+
+#endif // SETTINGSTEST_H
@@ -1,4 +1,32 @@
 #include "simpletest.h"
+#include <cstdlib>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+static QString writeFile(const QString &name, const QByteArray &contents)
+{
+    QString path = QDir::temp().filePath(name);
+    QFile file(path);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    file.write(contents);
+    return path;
+}
+
+void SimpleTest::record(
+        CommandLineParser *, CommandLineParser::ParsingResult result,
+        const QString &name, QVariant value, bool *)
+{
+    recorded << QString("%1:%2=%3").arg(result).arg(name, value.toString());
+}
+
+void SimpleTest::recordSlot(
+        CommandLineParser *parser, CommandLineParser::ParsingResult result,
+        const QString &name, QVariant value, bool *stop)
+{
+    record(parser, result, name, value, stop);
+}
 
 void SimpleTest::testRequired()
 {
@@ -139,3 +167,1020 @@ void SimpleTest::testSwitch()
     parser->parse(ARGS << "--a", CB(OptionUnknown));
     parser->parse(ARGS << "--a=foo", CB(OptionUnknown));
 }
+
+void SimpleTest::testOptionTable()
+{
+    D(Required, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("jobs"));
+          QCOMPARE(value, QVariant("4"));
+      });
+    D(SwitchOn, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("verbose"));
+          QCOMPARE(value, QVariant(true));
+      });
+    D(SwitchOff, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("verbose"));
+          QCOMPARE(value, QVariant(false));
+      });
+    D(OptionUnknown, {
+          QCOMPARE(result, CommandLineParser::OptionUnknown);
+      });
+
+    static const OptionDescription options[] = {
+        {"jobs", 'j', OptionValueRequired},
+        {"verbose", 'v', OptionValueNone},
+    };
+    parser->addOptions(options);
+
+    parser->parse(ARGS << "--jobs=4", CB(Required));
+    parser->parse(ARGS << "-j" << "4", CB(Required));
+    parser->parse(ARGS << "--verbose", CB(SwitchOn));
+    parser->parse(ARGS << "-v", CB(SwitchOn));
+    parser->parse(ARGS << "--no-verbose", CB(SwitchOff));
+    parser->parse(ARGS << "--no-jobs", CB(OptionUnknown));
+    parser->parse(ARGS << "--job", CB(OptionUnknown));
+
+    // Options added at runtime are found next to the table.
+    D(Runtime, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("extra"));
+      });
+    parser->addOption("extra", 'e', OptionSwitch);
+    parser->parse(ARGS << "--extra", CB(Runtime));
+    parser->parse(ARGS << "-j=4", CB(Required));
+
+    // The same goes for argv input.
+    char arg0[] = "_cmd";
+    char arg1[] = "--jobs=4";
+    char *argv[] = {arg0, arg1};
+    parser->parse(2, argv, CB(Required));
+}
+
+void SimpleTest::testManyOptions()
+{
+    static int found = 0;
+    D(Found, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("option-%1").arg(found));
+          found++;
+      });
+
+    int count = 2000;
+    QStringList args = ARGS;
+    for (int i = 0; i < count; i++)
+    {
+        parser->addOption(QString("option-%1").arg(i), QChar(), OptionSwitch);
+        args << QString("--option-%1").arg(i);
+    }
+    found = 0;
+    QVERIFY(parser->parse(args, CB(Found)));
+    QCOMPARE(found, count);
+}
+
+void SimpleTest::testAbbreviations()
+{
+    D(Verbose, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("verbose"));
+          QCOMPARE(value, QVariant(true));
+      });
+    D(NotVerbose, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("verbose"));
+          QCOMPARE(value, QVariant(false));
+      });
+    D(Jobs, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("jobs"));
+          QCOMPARE(value, QVariant("4"));
+      });
+    D(OptionAmbiguous, {
+          QCOMPARE(result, CommandLineParser::OptionAmbiguous);
+      });
+    D(OptionUnknown, {
+          QCOMPARE(result, CommandLineParser::OptionUnknown);
+      });
+
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->addOption("version", QChar(), OptionSwitch);
+    parser->addOption("jobs", 'j', OptionValueRequired);
+
+    // Abbreviations are off by default.
+    parser->parse(ARGS << "--verb", CB(OptionUnknown));
+
+    parser->setAbbreviationsEnabled(true);
+    parser->parse(ARGS << "--verbose", CB(Verbose));
+    parser->parse(ARGS << "--verb", CB(Verbose));
+    parser->parse(ARGS << "--no-verb", CB(NotVerbose));
+    parser->parse(ARGS << "--jo=4", CB(Jobs));
+    parser->parse(ARGS << "--j" << "4", CB(Jobs));
+    parser->parse(ARGS << "--ver", CB(OptionAmbiguous));
+    parser->parse(ARGS << "--v", CB(OptionAmbiguous));
+    parser->parse(ARGS << "--x", CB(OptionUnknown));
+
+    // Aliases are never abbreviations.
+    parser->parse(ARGS << "-ve", CB(OptionUnknown));
+}
+
+void SimpleTest::testGroups()
+{
+    D(GroupSelected, {
+          if (result == CommandLineParser::OptionFound && name == "build")
+              return;
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("jobs"));
+          QCOMPARE(parser->currentGroupName(), QString("build"));
+      });
+    D(NoGroup, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(parser->currentGroupName(), QString());
+      });
+    D(GroupMismatch, {
+          if (result == CommandLineParser::OptionFound && name == "build")
+              return;
+          QCOMPARE(result, CommandLineParser::GroupMismatch);
+          QCOMPARE(name, QString("--verbose"));
+      });
+    D(ValueMissing, {
+          if (result == CommandLineParser::OptionFound && name == "build")
+              return;
+          QCOMPARE(result, CommandLineParser::ValueMissing);
+          QCOMPARE(name, QString("jobs"));
+      });
+
+    parser->beginOptionGroup("build");
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->endOptionGroup();
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->freeze();
+
+    QVERIFY(parser->parse(ARGS << "build" << "--jobs=4", CB(GroupSelected)));
+    QVERIFY(parser->parse(ARGS << "build" << "-j" << "4", CB(GroupSelected)));
+    QVERIFY(parser->parse(ARGS << "--verbose", CB(NoGroup)));
+    QVERIFY(!parser->parse(ARGS << "build" << "--verbose", CB(GroupMismatch)));
+
+    // A group name never counts as a value.
+    parser->parse(ARGS << "--jobs" << "build", CB(ValueMissing));
+
+    // Options registered after freezing are picked up by the next parse.
+    D(Late, {
+          QCOMPARE(result, CommandLineParser::OptionFound);
+          QCOMPARE(name, QString("late"));
+      });
+    parser->addOption("late", QChar(), OptionSwitch);
+    QVERIFY(parser->parse(ARGS << "--late", CB(Late)));
+
+    // Groups with more options than fit into one word of their bitset.
+    D(Any, {});
+    parser->beginOptionGroup("even");
+    for (int i = 0; i < 100; i += 2)
+        parser->addOption(QString("option-%1").arg(i), QChar(), OptionSwitch);
+    parser->endOptionGroup();
+    parser->beginOptionGroup("odd");
+    for (int i = 1; i < 100; i += 2)
+        parser->addOption(QString("option-%1").arg(i), QChar(), OptionSwitch);
+    parser->endOptionGroup();
+    QVERIFY(parser->parse(ARGS << "even" << "--option-98", CB(Any)));
+    QVERIFY(parser->parse(ARGS << "odd" << "--option-99", CB(Any)));
+    QVERIFY(!parser->parse(ARGS << "even" << "--option-99", CB(Any)));
+    QVERIFY(!parser->parse(ARGS << "odd" << "--option-0", CB(Any)));
+    QVERIFY(parser->parse(ARGS << "--option-0" << "--option-99", CB(Any)));
+}
+
+void SimpleTest::testCallbacks()
+{
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("verbose", 'v', OptionValueNone);
+
+    QStringList args = ARGS << "--jobs" << "4" << "--no-verbose" << "foo";
+    QStringList expected;
+    expected << QString("%1:jobs=4").arg(CommandLineParser::OptionFound)
+             << QString("%1:verbose=false").arg(CommandLineParser::OptionFound)
+             << QString("%1:=foo").arg(CommandLineParser::ArgumentFound);
+
+    // Slot looked up by name.
+    recorded.clear();
+    QVERIFY(parser->parse(args, this, "recordSlot"));
+    QCOMPARE(recorded, expected);
+
+    // Member function pointer.
+    recorded.clear();
+    QVERIFY(parser->parse(args, this, &SimpleTest::record));
+    QCOMPARE(recorded, expected);
+
+#ifdef Q_COMPILER_LAMBDA
+    // Lambda.
+    QStringList lambdaRecorded;
+    QVERIFY(parser->parse(args, [&lambdaRecorded](
+                CommandLineParser *, CommandLineParser::ParsingResult result,
+                const QString &name, QVariant value, bool *) {
+        lambdaRecorded << QString("%1:%2=%3").arg(result).arg(
+                              name, value.toString());
+    }));
+    QCOMPARE(lambdaRecorded, expected);
+
+    // Lambdas can stop parsing like any other callback.
+    int count = 0;
+    QVERIFY(!parser->parse(args, [&count](
+                CommandLineParser *, CommandLineParser::ParsingResult,
+                const QString &, QVariant, bool *stop) {
+        count++;
+        *stop = true;
+    }));
+    QCOMPARE(count, 1);
+#endif
+}
+
+void SimpleTest::testParseResult()
+{
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("verbose", 'v', OptionNegativeSwitch);
+    parser->addOption("color", QChar(), OptionValueOptional);
+    QCOMPARE(parser->optionIndex("jobs"), 0);
+    QCOMPARE(parser->optionIndex("verbose"), 1);
+    QCOMPARE(parser->optionIndex("color"), 2);
+    QCOMPARE(parser->optionIndex("bogus"), -1);
+
+    QStringList args = ARGS << "-j" << "4" << "foo" << "--no-verbose"
+                            << "--color" << "--jobs=8" << "--" << "--bar";
+    ParseResult result = parser->parseAll(args);
+    QVERIFY(result.isSuccess());
+
+    QCOMPARE(result.optionCount(), 4);
+    const int *indexes = result.optionIndexes();
+    QCOMPARE(indexes[0], 0);
+    QCOMPARE(indexes[1], 1);
+    QCOMPARE(indexes[2], 2);
+    QCOMPARE(indexes[3], 0);
+    QCOMPARE(result.optionName(1), QString("verbose"));
+    QCOMPARE(result.optionValue(0), QString("4"));
+    QCOMPARE(result.optionValue(1), QString("false"));
+    QCOMPARE(result.optionValue(2), QString("true"));
+    QCOMPARE(result.text(result.optionValues()[3]), QString("8"));
+
+    QCOMPARE(result.value("jobs"), QString("8"));
+    QCOMPARE(result.values("jobs"), QStringList() << "4" << "8");
+    QVERIFY(!result.contains("bogus"));
+    QCOMPARE(result.value("bogus", "x"), QString("x"));
+    QCOMPARE(result.argumentList(), QStringList() << "foo" << "--bar");
+
+    // Copies share the data.
+    ParseResult copy = result;
+    QCOMPARE(copy.buffer(), result.buffer());
+
+    args = ARGS << "--bogus" << "--jobs";
+    result = parser->parseAll(args);
+    QVERIFY(!result.isSuccess());
+    QCOMPARE(result.optionCount(), 0);
+    QCOMPARE(result.errorCount(), 2);
+    QCOMPARE(result.errors()[0].result, CommandLineParser::OptionUnknown);
+    QCOMPARE(result.errors()[0].token, 1);
+    QCOMPARE(result.errorName(0), QString("--bogus"));
+    QCOMPARE(result.errors()[1].result, CommandLineParser::ValueMissing);
+    QCOMPARE(result.errorName(1), QString("jobs"));
+
+    // A result can be parsed into again, replacing what it held.
+    QVERIFY(parser->parseAll(ARGS << "-j" << "2" << "bar", &result));
+    QVERIFY(result.isSuccess());
+    QCOMPARE(result.optionCount(), 1);
+    QCOMPARE(result.optionValue(0), QString("2"));
+    QCOMPARE(result.argumentList(), QStringList() << "bar");
+
+    // Copies keep what they had.
+    ParseResult kept = result;
+    QVERIFY(!parser->parseAll(ARGS << "--bogus", &result));
+    QCOMPARE(result.optionCount(), 0);
+    QCOMPARE(result.argumentCount(), 0);
+    QCOMPARE(result.errorName(0), QString("--bogus"));
+    QCOMPARE(kept.optionValue(0), QString("2"));
+}
+
+void SimpleTest::testBinding()
+{
+    int jobs = 0;
+    qint64 size = 0;
+    double ratio = 0.0;
+    bool verbose = true;
+    QString name;
+    QStringList includes;
+    CommandLineParser::ParsingResult mode = CommandLineParser::OptionFound;
+
+    const QMetaObject &meta = CommandLineParser::staticMetaObject;
+    QMetaEnum modes = meta.enumerator(meta.indexOfEnumerator("ParsingResult"));
+
+    parser->addOption("jobs", 'j', &jobs);
+    parser->addOption("size", QChar(), &size);
+    parser->addOption("ratio", QChar(), &ratio);
+    parser->addOption("verbose", 'v', &verbose, OptionNegativeSwitch);
+    parser->addOption("name", QChar(), &name);
+    parser->addOption("include", 'I', &includes);
+    parser->addOption("mode", QChar(), &mode, modes);
+
+    // Bound options are not reported, only arguments are.
+    recorded.clear();
+    QVERIFY(parser->parse(ARGS << "-j" << "-12" << "--size=9000000000"
+                               << "--ratio" << "2.5" << "--no-verbose"
+                               << "--name" << "foo" << "-I" << "a" << "-I=b"
+                               << "--mode=GroupMismatch" << "bar",
+                          this, &SimpleTest::record));
+    QCOMPARE(recorded, QStringList() << QString("%1:=bar").arg(
+                 CommandLineParser::ArgumentFound));
+    QCOMPARE(jobs, -12);
+    QCOMPARE(size, Q_INT64_C(9000000000));
+    QCOMPARE(ratio, 2.5);
+    QCOMPARE(verbose, false);
+    QCOMPARE(name, QString("foo"));
+    QCOMPARE(includes, QStringList() << "a" << "b");
+    QCOMPARE(mode, CommandLineParser::GroupMismatch);
+
+    QVERIFY(parser->parse(ARGS << "--verbose" << "--mode" << "1"));
+    QCOMPARE(verbose, true);
+    QCOMPARE(mode, CommandLineParser::ArgumentFound);
+
+    // Invalid values are reported, and leave the variable alone.
+    D(ValueInvalid, {
+          QCOMPARE(result, CommandLineParser::ValueInvalid);
+          QCOMPARE(name, QString("jobs"));
+          QCOMPARE(value, QVariant("4x"));
+      });
+    QVERIFY(!parser->parse(ARGS << "--jobs=4x", CB(ValueInvalid)));
+    QCOMPARE(jobs, -12);
+
+    recorded.clear();
+    QVERIFY(!parser->parse(ARGS << "--jobs=99999999999" << "--ratio=1,5"
+                                << "--mode=Bogus",
+                           this, &SimpleTest::record));
+    QCOMPARE(recorded.size(), 3);
+    QCOMPARE(jobs, -12);
+    QCOMPARE(ratio, 2.5);
+    QCOMPARE(mode, CommandLineParser::ArgumentFound);
+
+    // Bool values are read like those of unbound switches.
+    bool color = false;
+    parser->addOption("color", QChar(), &color, OptionValueOptional);
+    parser->addOption("plain", QChar(), OptionSwitch);
+    ParseResult result = parser->parseAll(ARGS << "--plain=no");
+    QCOMPARE(result.value("plain"), QString("true"));
+    QVERIFY(parser->parse(ARGS << "--color=no"));
+    QCOMPARE(color, true);
+    QVERIFY(parser->parse(ARGS << "--color=FALSE"));
+    QCOMPARE(color, false);
+
+    // Optional values not given set bool targets, and leave others alone.
+    int level = 3;
+    QString label("kept");
+    parser->addOption("level", QChar(), &level, OptionValueOptional);
+    parser->addOption("label", QChar(), &label, OptionValueOptional);
+    QVERIFY(parser->parse(ARGS << "--color" << "--level" << "--label"));
+    QCOMPARE(color, true);
+    QCOMPARE(level, 3);
+    QCOMPARE(label, QString("kept"));
+}
+
+void SimpleTest::testResponseFiles()
+{
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("verbose", 'v', OptionValueNone);
+
+    QString inner = writeFile("qcli-inner.rsp", "bar\n");
+    QString outer = writeFile("qcli-outer.rsp", QByteArray(
+                                  "  --jobs\t4 foo\n@") + inner.toLocal8Bit() +
+                              " --verbose\n");
+    QStringList args = ARGS << "@" + outer << "baz";
+
+    // Disabled by default.
+    ParseResult result = parser->parseAll(args);
+    QCOMPARE(result.argumentList(), QStringList() << "@" + outer << "baz");
+
+    parser->setResponseFilesEnabled(true);
+    result = parser->parseAll(args);
+    QVERIFY(result.isSuccess());
+    QCOMPARE(result.value("jobs"), QString("4"));
+    QCOMPARE(result.value("verbose"), QString("true"));
+    QCOMPARE(result.argumentList(), QStringList() << "foo" << "bar" << "baz");
+
+    // A value can come from the response file.
+    QString value = writeFile("qcli-value.rsp", "8");
+    result = parser->parseAll(ARGS << "--jobs" << "@" + value);
+    QCOMPARE(result.value("jobs"), QString("8"));
+
+    // One argument per line, or per NUL.
+    parser->setResponseFileFormat(CommandLineParser::ResponseFileLines);
+    QString lines = writeFile("qcli-lines.rsp", "a b\r\n\n--jobs=2\n");
+    result = parser->parseAll(ARGS << "@" + lines);
+    QCOMPARE(result.argumentList(), QStringList() << "a b");
+    QCOMPARE(result.value("jobs"), QString("2"));
+
+    parser->setResponseFileFormat(CommandLineParser::ResponseFileNul);
+    QString nul = writeFile("qcli-nul.rsp", QByteArray("a\nb\0\0c\0", 8));
+    result = parser->parseAll(ARGS << "@" + nul);
+    QCOMPARE(result.argumentList(), QStringList() << "a\nb" << "" << "c");
+
+    // Missing files, and files over the limit, are errors.
+    D(ResponseFileError, {
+          QCOMPARE(result, CommandLineParser::ResponseFileError);
+      });
+    QVERIFY(!parser->parse(ARGS << "@/nonexistent/qcli.rsp",
+                           CB(ResponseFileError)));
+    parser->setResponseFileSizeLimit(4);
+    result = parser->parseAll(ARGS << "@" + nul);
+    QCOMPARE(result.errorCount(), 1);
+    QCOMPARE(result.errors()[0].result, CommandLineParser::ResponseFileError);
+    QCOMPARE(result.errorName(0), nul);
+
+    // Files rejected do not count toward the limit.
+    result = parser->parseAll(ARGS << "@" + nul << "--jobs" << "@" + value);
+    QCOMPARE(result.errorCount(), 1);
+    QCOMPARE(result.value("jobs"), QString("8"));
+
+    QFile::remove(inner);
+    QFile::remove(outer);
+    QFile::remove(value);
+    QFile::remove(lines);
+    QFile::remove(nul);
+}
+
+void SimpleTest::testFeed()
+{
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("color", 'c', OptionValueOptional);
+    parser->addOption("verbose", 'v', OptionValueNone);
+
+    // Options waiting for a value are reported once the next token arrives.
+    recorded.clear();
+    parser->beginFeed(this, "recordSlot");
+    QVERIFY(parser->feed("--jobs"));
+    QVERIFY(recorded.isEmpty());
+    QVERIFY(parser->feed(QString("4")));
+    QCOMPARE(recorded, QStringList() << QString("%1:jobs=4").arg(
+                 CommandLineParser::OptionFound));
+    QVERIFY(parser->feed("--color"));
+    QVERIFY(parser->feed("-v"));
+    QCOMPARE(recorded.size(), 3);
+    QCOMPARE(recorded.at(1), QString("%1:color=true").arg(
+                 CommandLineParser::OptionFound));
+    QVERIFY(parser->feed("--jobs"));
+    QVERIFY(parser->finish());
+    QCOMPARE(recorded.last(), QString("%1:jobs=").arg(
+                 CommandLineParser::ValueMissing));
+    QVERIFY(!parser->feed("more"));
+
+    // Feeding many tokens without keeping a result.
+    int count = 0;
+    parser->beginFeed(this, "recordSlot");
+    recorded.clear();
+    for (int i = 0; i < 10000; i++)
+    {
+        QVERIFY(parser->feed("--verbose"));
+        count++;
+        if (recorded.size() > 100)
+            recorded.clear();
+    }
+    QVERIFY(parser->finish());
+    QCOMPARE(count, 10000);
+    QCOMPARE(parser->feedResult().optionCount(), 0);
+
+    // Or keeping it.
+    parser->beginFeed(this, "recordSlot", true);
+    parser->feed("-j");
+    parser->feed("2");
+    parser->feed("--");
+    parser->feed("-v");
+    QVERIFY(parser->finish());
+    ParseResult result = parser->feedResult();
+    QCOMPARE(result.value("jobs"), QString("2"));
+    QCOMPARE(result.argumentList(), QStringList() << "-v");
+}
+
+void SimpleTest::testParallel()
+{
+    parser->beginOptionGroup("build");
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->endOptionGroup();
+    parser->addOption("color", 'c', OptionValueOptional);
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->setParallelThreshold(1000);
+
+    // Every kind of token, in every position relative to options waiting for
+    // a value, and across the blocks the tokens are classified in.
+    QStringList pattern;
+    pattern << "--jobs" << "4" << "-j" << "--color" << "build" << "--verbose"
+            << "x" << "--jobs=2" << "--bogus" << "-c" << "blue"
+            << "--no-verbose" << "-j" << "build" << "--color=" << "-";
+    QStringList args = ARGS;
+    for (int i = 0; i < 100000; i++)
+    {
+        if (i == 90000)
+            args << "--";
+        args << pattern.at(i % pattern.size());
+    }
+
+    recorded.clear();
+    bool sequential = parser->parse(args, this, &SimpleTest::record);
+    QStringList expected = recorded;
+    ParseResult expectedResult = parser->parseAll(args);
+    QVERIFY(expected.size() > 50000);
+
+    for (int threads = 2; threads <= 8; threads *= 2)
+    {
+        parser->setParsingThreadCount(threads);
+        recorded.clear();
+        QCOMPARE(parser->parse(args, this, &SimpleTest::record), sequential);
+        QCOMPARE(recorded, expected);
+
+        ParseResult result = parser->parseAll(args);
+        QCOMPARE(result.optionCount(), expectedResult.optionCount());
+        for (int i = 0; i < result.optionCount(); i++)
+        {
+            QCOMPARE(result.optionName(i), expectedResult.optionName(i));
+            QCOMPARE(result.optionValue(i), expectedResult.optionValue(i));
+        }
+        QCOMPARE(result.argumentList(), expectedResult.argumentList());
+        QCOMPARE(result.errorCount(), expectedResult.errorCount());
+        QCOMPARE(result.groupName(), expectedResult.groupName());
+    }
+
+    // Stopping works the same, too.
+    static int reported;
+    D(StopLate, {
+          if (++reported == 60000)
+              *ok = true;
+      });
+    reported = 0;
+    QVERIFY(!parser->parse(args, CB(StopLate)));
+    QCOMPARE(reported, 60000);
+}
+
+void SimpleTest::testLongTokens()
+{
+    parser->addOption("a-rather-long-option-name", QChar(),
+                      OptionValueRequired);
+    parser->addOption("verbose", 'v', OptionValueNone);
+
+    // Names and values longer than a vector register, with the equal sign at
+    // either side of the boundary.
+    QString value = QString(40, QChar('x')) + "=y";
+    QStringList args = ARGS << "--a-rather-long-option-name=" + value
+                            << "--a-rather-long-option-name" << "=" + value
+                            << "--verbose=" + value
+                            << "--a-rather-long-option-name-too=1";
+    ParseResult result = parser->parseAll(args);
+    QCOMPARE(result.values("a-rather-long-option-name"),
+             QStringList() << value << "=" + value);
+    QCOMPARE(result.value("verbose"), QString("true"));
+    QCOMPARE(result.errorCount(), 1);
+    QCOMPARE(result.errorName(0),
+             QString("--a-rather-long-option-name-too=1"));
+
+    // Local 8-bit input that is not ASCII only past the first 16 bytes.
+    char arg0[] = "_cmd";
+    char arg1[] = "--a-rather-long-option-name=caf\xc3\xa9";
+    char arg2[] = "--a-rather-long-option-nam\xc3\xa9=1";
+    char *argv[] = {arg0, arg1, arg2};
+    result = parser->parseAll(3, argv);
+    QCOMPARE(result.optionCount(), 1);
+    QCOMPARE(result.optionValue(0), QString::fromLocal8Bit("caf\xc3\xa9"));
+    QCOMPARE(result.errorCount(), 1);
+}
+
+void SimpleTest::testStatistics()
+{
+    // Counters are only kept if the library is built to keep them.
+    if (!CommandLineParser::statisticsEnabled())
+        return;
+
+    D(Ignore, {});
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->resetStatistics();
+    parser->parse(ARGS << "--jobs" << "4" << "-v" << "foo" << "--bogus",
+                  CB(Ignore));
+
+    CommandLineParser::Statistics statistics = parser->statistics();
+    QCOMPARE(statistics.parses, quint64(1));
+    QCOMPARE(statistics.tokens, quint64(5));
+    QCOMPARE(statistics.dictionaryProbes, quint64(3));
+    QCOMPARE(statistics.groupProbes, quint64(2));
+    QCOMPARE(statistics.lookaheadChecks, quint64(1));
+    QCOMPARE(statistics.findings[CommandLineParser::OptionFound], quint64(2));
+    QCOMPARE(statistics.findings[CommandLineParser::ArgumentFound],
+             quint64(1));
+    QCOMPARE(statistics.findings[CommandLineParser::OptionUnknown],
+             quint64(1));
+    QCOMPARE(statistics.variantConversions, quint64(4));
+    QCOMPARE(statistics.stringAllocations, quint64(0));
+    QVERIFY(statistics.parseTime > 0);
+
+    // Values taken from part of a token have to be copied.
+    char arg0[] = "_cmd";
+    char arg1[] = "--jobs=4";
+    char *argv[] = {arg0, arg1};
+    parser->resetStatistics();
+    parser->parse(2, argv, CB(Ignore));
+    QCOMPARE(parser->statistics().stringAllocations, quint64(1));
+
+    // Results are built without going through QVariant.
+    parser->resetStatistics();
+    parser->parseAll(ARGS << "--jobs=4");
+    QCOMPARE(parser->statistics().variantConversions, quint64(0));
+}
+
+namespace
+{
+
+QAtomicInt groupMismatches;
+
+// Callbacks must see the group selected by their own parse.
+void checkGroup(CommandLineParser *parser,
+                CommandLineParser::ParsingResult result,
+                const QString &name, QVariant, bool *)
+{
+    if (result != CommandLineParser::OptionFound)
+        return;
+    if ((name == "jobs" && parser->currentGroupName() != "build") ||
+        (name == "filter" && parser->currentGroupName() != "test"))
+        groupMismatches.ref();
+}
+
+class ParseThread : public QThread
+{
+public:
+    ParseThread(CommandLineParser *parser, const QList<QStringList> &inputs,
+                const QList<ParseResult> &expected, int first) :
+        parser(parser), inputs(inputs), expected(expected), first(first),
+        failures(0) {}
+
+    void run()
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            int k = (first + i) % inputs.size();
+            if (!parser->parse(inputs.at(k), &checkGroup))
+                failures++;
+            ParseResult result = parser->parseAll(inputs.at(k));
+            const ParseResult &other = expected.at(k);
+            if (result.groupName() != other.groupName() ||
+                result.optionCount() != other.optionCount() ||
+                result.argumentList() != other.argumentList())
+            {
+                failures++;
+                continue;
+            }
+            for (int j = 0; j < result.optionCount(); j++)
+            {
+                if (result.optionValue(j) != other.optionValue(j))
+                    failures++;
+            }
+        }
+    }
+
+    CommandLineParser *parser;
+    QList<QStringList> inputs;
+    QList<ParseResult> expected;
+    int first;
+    int failures;
+};
+
+}   // namespace
+
+// Meant to be run under ThreadSanitizer as well (see tests.pro).
+void SimpleTest::testConcurrentParsing()
+{
+    parser->beginOptionGroup("build");
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->endOptionGroup();
+    parser->beginOptionGroup("test");
+    parser->addOption("filter", 'f', OptionValueRequired);
+    parser->endOptionGroup();
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->setAbbreviationsEnabled(true);
+    parser->setParallelThreshold(1000);
+    parser->setParsingThreadCount(2);
+    parser->freeze();
+
+    // Long enough for one input to be classified on the shared pool.
+    QStringList many = ARGS << "build";
+    for (int i = 0; i < 2000; i++)
+        many << "--jobs" << QString::number(i) << "-v" << "file";
+
+    QList<QStringList> inputs;
+    inputs << (ARGS << "build" << "--jobs=4" << "--verb" << "a" << "b")
+           << (ARGS << "test" << "-f" << "unit" << "--no-verbose")
+           << (ARGS << QString::fromUtf8("\xc3\xa9t\xc3\xa9") << "-v" << "--")
+           << (ARGS << "test" << "--filter"
+               << QString::fromUtf8("\xc3\xbc" "ber") << "--verbose")
+           << many;
+    QList<ParseResult> expected;
+    for (int i = 0; i < inputs.size(); i++)
+        expected << parser->parseAll(inputs.at(i));
+    QCOMPARE(expected.at(0).groupName(), QString("build"));
+    QCOMPARE(expected.at(1).groupName(), QString("test"));
+
+    parser->resetStatistics();
+    groupMismatches = 0;
+    QList<ParseThread *> threads;
+    for (int i = 0; i < 8; i++)
+        threads << new ParseThread(parser, inputs, expected, i);
+    for (int i = 0; i < threads.size(); i++)
+        threads.at(i)->start();
+    for (int i = 0; i < threads.size(); i++)
+    {
+        threads.at(i)->wait();
+        QCOMPARE(threads.at(i)->failures, 0);
+    }
+    qDeleteAll(threads);
+    QCOMPARE(int(groupMismatches), 0);
+
+    if (CommandLineParser::statisticsEnabled())
+        QCOMPARE(parser->statistics().parses, quint64(8 * 200 * 2));
+}
+
+void SimpleTest::testCommandStrings()
+{
+    QStringList words;
+    QVERIFY(CommandLineParser::splitCommand(
+                "run --jobs=4 \"my file.txt\"", &words));
+    QCOMPARE(words, QStringList() << "run" << "--jobs=4" << "my file.txt");
+
+    // Quoting and escaping, as in a POSIX shell.
+    QVERIFY(CommandLineParser::splitCommand(
+                " a'b c'd \"x\\\"y\\z\" 'p\\q' r\\ s \"\" #e f\ng", &words));
+    QCOMPARE(words, QStringList() << "ab cd" << "x\"y\\z" << "p\\q" << "r s"
+                                  << "" << "g");
+    QVERIFY(CommandLineParser::splitCommand("a \\\nb c\\\nd", &words));
+    QCOMPARE(words, QStringList() << "a" << "b" << "cd");
+    QVERIFY(!CommandLineParser::splitCommand("a 'b", &words));
+    QVERIFY(!CommandLineParser::splitCommand("a \"b\\\"", &words));
+    QVERIFY(!CommandLineParser::splitCommand("a b\\", &words));
+
+    parser->beginOptionGroup("build");
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->endOptionGroup();
+    parser->addOption("output", 'o', OptionValueRequired);
+
+    // Parsed like the same words given as arguments.
+    recorded.clear();
+    parser->parse(ARGS << "build" << "-j" << "4" << "--output=my dir" << "a b",
+                  this, &SimpleTest::record);
+    QStringList expected = recorded;
+    recorded.clear();
+    QVERIFY(parser->parseCommand("run build -j 4 --output='my dir' a\\ b",
+                                 this, "recordSlot"));
+    QCOMPARE(recorded, expected);
+
+    ParseResult result = parser->parseAllCommand(
+                "run build --jobs \"1 2\" -- \"--output\"");
+    QCOMPARE(result.groupName(), QString("build"));
+    QCOMPARE(result.values("jobs"), QStringList() << "1 2");
+    QCOMPARE(result.argumentList(), QStringList() << "--output");
+
+    // A command that cannot be split is not parsed at all.
+    D(QuotingError, {
+          QCOMPARE(result, CommandLineParser::QuotingError);
+          QCOMPARE(name, QString("\"b c"));
+      });
+    QVERIFY(!parser->parseCommand("run --jobs=4 \"b c", CB(QuotingError)));
+    result = parser->parseAllCommand("run --jobs=4 \"b c");
+    QCOMPARE(result.optionCount(), 0);
+    QCOMPARE(result.errorCount(), 1);
+    QCOMPARE(result.errors()[0].result, CommandLineParser::QuotingError);
+}
+
+namespace
+{
+
+QStringList loadedSubcommands;
+
+void addRemoteAddOptions(CommandLineParser *parser, const QString &path)
+{
+    loadedSubcommands << path;
+    parser->addOption("fetch", 'f', OptionSwitch);
+}
+
+void addRemoteOptions(CommandLineParser *parser, const QString &path)
+{
+    loadedSubcommands << path;
+    parser->addOption("verbose", 'v', OptionSwitch);
+    parser->addSubcommand("remote add", &addRemoteAddOptions);
+}
+
+void addOtherOptions(CommandLineParser *parser, const QString &path)
+{
+    loadedSubcommands << path;
+    parser->addOption("other", QChar(), OptionSwitch);
+}
+
+}   // namespace
+
+void SimpleTest::testSubcommands()
+{
+    parser->addOption("config", 'c', OptionValueRequired);
+    parser->addSubcommand("remote", &addRemoteOptions);
+    for (int i = 0; i < 100; i++)
+        parser->addSubcommand(QString("other-%1").arg(i), &addOtherOptions);
+    loadedSubcommands.clear();
+
+    // Only the subcommands on the path are set up, enclosing ones first.
+    ParseResult result = parser->parseAll(
+                ARGS << "-c" << "x" << "remote" << "-v" << "add" << "-f"
+                     << "--verbose" << "origin" << "remote");
+    QCOMPARE(loadedSubcommands, QStringList() << "remote" << "remote add");
+    QCOMPARE(result.groupName(), QString("remote add"));
+    QCOMPARE(result.values("config"), QStringList() << "x");
+    QCOMPARE(result.values("verbose"), QStringList() << "true" << "true");
+    QCOMPARE(result.values("fetch"), QStringList() << "true");
+    QCOMPARE(result.argumentList(), QStringList() << "origin" << "remote");
+    QCOMPARE(result.errorCount(), 0);
+
+    // Once set up, subcommands are not set up again. Their options are
+    // unknown outside of them, and subcommand names taken as values are
+    // values.
+    result = parser->parseAll(ARGS << "-c" << "remote" << "--fetch");
+    QCOMPARE(loadedSubcommands.size(), 2);
+    QCOMPARE(result.values("config"), QStringList() << "remote");
+    QCOMPARE(result.errorCount(), 1);
+    QCOMPARE(result.errors()[0].result, CommandLineParser::GroupMismatch);
+
+    result = parser->parseAll(ARGS << "other-7" << "--other" << "--fetch");
+    QCOMPARE(loadedSubcommands.size(), 3);
+    QCOMPARE(result.groupName(), QString("other-7"));
+    QCOMPARE(result.values("other"), QStringList() << "true");
+    QCOMPARE(result.errorCount(), 1);
+
+    // Callbacks see the subcommand entered.
+    D(Remote, {
+          if (name == "add")
+              QCOMPARE(parser->currentGroupName(), QString("remote add"));
+      });
+    QVERIFY(parser->parse(ARGS << "remote" << "add", CB(Remote)));
+
+    // Subcommands can also be set up ahead of time.
+    parser->loadSubcommand("other-8");
+    QCOMPARE(loadedSubcommands.size(), 4);
+
+    // Freezing sets up the rest, so that parses do not change the parser.
+    parser->freeze();
+    QCOMPARE(loadedSubcommands.size(), 102);
+    result = parser->parseAll(ARGS << "other-9" << "--other");
+    QCOMPARE(loadedSubcommands.size(), 102);
+    QCOMPARE(result.values("other"), QStringList() << "true");
+}
+
+namespace
+{
+
+void addCompletedRemoteOptions(CommandLineParser *parser, const QString &)
+{
+    parser->addOption("force", QChar(), OptionSwitch);
+    parser->addSubcommand("remote add", &addRemoteAddOptions);
+}
+
+}   // namespace
+
+void SimpleTest::testCompletion()
+{
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("verbose", 'v', OptionValueNone);
+    parser->beginOptionGroup("build");
+    parser->addOption("target", QChar(), OptionValueRequired);
+    parser->endOptionGroup();
+    parser->beginOptionGroup("test");
+    parser->endOptionGroup();
+    parser->addSubcommand("remote", &addCompletedRemoteOptions);
+
+    QStringList all;
+    all << "--jobs" << "--no-verbose" << "--target" << "--verbose";
+    QCOMPARE(parser->complete(ARGS << "--"), all);
+    QCOMPARE(parser->complete(ARGS << "-"), all << "-j" << "-v");
+    QCOMPARE(parser->complete(ARGS << "--v"), QStringList() << "--verbose");
+    QCOMPARE(parser->complete(ARGS << "--jobs=4" << "--t"),
+             QStringList() << "--target");
+    QCOMPARE(parser->complete(ARGS << ""),
+             QStringList() << "build" << "remote" << "test");
+    QCOMPARE(parser->complete(ARGS << "te"), QStringList() << "test");
+
+    // Values, arguments and anything after "--" are left to the shell.
+    QVERIFY(parser->complete(ARGS << "--jobs" << "").isEmpty());
+    QVERIFY(parser->complete(ARGS << "--verbose=").isEmpty());
+    QVERIFY(parser->complete(ARGS << "--" << "-").isEmpty());
+    QCOMPARE(parser->complete(ARGS << "--jobs" << "--v"),
+             QStringList() << "--verbose");
+
+    // Only what is valid in the group or subcommand selected.
+    QCOMPARE(parser->complete(ARGS << "build" << "--"),
+             QStringList() << "--target");
+    QCOMPARE(parser->complete(ARGS << "remote" << ""),
+             QStringList() << "add" << "build" << "test");
+    QCOMPARE(parser->complete(ARGS << "remote" << "--"),
+             QStringList() << "--force");
+    QCOMPARE(parser->complete(ARGS << "remote" << "add" << "--f"),
+             QStringList() << "--fetch" << "--force");
+    QCOMPARE(parser->complete(ARGS << "file" << ""),
+             QStringList() << "build" << "test");
+
+    // The shell glue calls into the program like this.
+    QBuffer *out = new QBuffer();
+    out->open(QIODevice::WriteOnly);
+    parser->redirectStdOut(out);
+    char arg0[] = "/usr/bin/my-tool";
+    char arg1[] = "--complete";
+    char arg2[] = "my-tool";
+    char arg3[] = "--v";
+    char *argv[] = {arg0, arg1, arg2, arg3};
+    QVERIFY(parser->handleCompletion(4, argv));
+    QCOMPARE(out->data(), QByteArray("--verbose\n"));
+
+    char script[] = "--completion-script";
+    char zsh[] = "zsh";
+    char *scriptArgv[] = {arg0, script, zsh};
+    QVERIFY(parser->handleCompletion(3, scriptArgv));
+    QVERIFY(out->data().contains("compdef _qcli_complete_my_tool my-tool"));
+    QVERIFY(!parser->handleCompletion(2, argv + 2));
+    QVERIFY(CommandLineParser::completionScript("my-tool",
+                CommandLineParser::BashCompletion).contains(
+                    "complete -o default -F _qcli_complete_my_tool my-tool"));
+}
+
+namespace
+{
+
+// Sets environment variables until it goes out of scope, so that they do not
+// leak into later tests even if the test fails.
+class ScopedEnvironment
+{
+public:
+    ~ScopedEnvironment()
+    {
+        foreach (const QByteArray &name, names)
+        {
+#if QT_VERSION >= 0x050100
+            qunsetenv(name.constData());
+#elif defined(Q_OS_WIN)
+            qputenv(name.constData(), QByteArray());    // Removes it.
+#else
+            unsetenv(name.constData());
+#endif
+        }
+    }
+
+    void set(const char *name, const QByteArray &value)
+    {
+        names.append(name);
+        qputenv(name, value);
+    }
+
+private:
+    QList<QByteArray> names;
+};
+
+}   // namespace
+
+void SimpleTest::testEnvironment()
+{
+    ScopedEnvironment environment;
+    environment.set("QCLITEST_JOBS", "8");
+    environment.set("QCLITEST_DRY_RUN", "yes");
+    environment.set("QCLITEST_COLOUR", "never");
+    environment.set("QCLITEST_IGNORED", "1");
+    parser->addOption("jobs", 'j', OptionValueRequired);
+    parser->addOption("dry-run", QChar(), OptionValueNone);
+    parser->addOption("color", QChar(), OptionValueOptional);
+    parser->addOption("ignored", QChar(), OptionSwitch);
+
+    // Nothing is read unless asked for.
+    ParseResult result = parser->parseAll(ARGS << "foo");
+    QCOMPARE(result.optionCount(), 0);
+
+    parser->setEnvironmentPrefix("QCLITEST_");
+    parser->setEnvironmentVariable("color", "QCLITEST_COLOUR");
+    parser->setEnvironmentVariable("ignored", QString());
+    result = parser->parseAll(ARGS << "--jobs=2");
+    QVERIFY(result.isSuccess());
+    QCOMPARE(result.values("jobs"), QStringList() << "8" << "2");
+    QCOMPARE(result.value("dry-run"), QString("true"));
+    QCOMPARE(result.value("color"), QString("never"));
+    QVERIFY(!result.contains("ignored"));
+
+    parser->setEnvironmentPrecedence(
+                CommandLineParser::EnvironmentOverArguments);
+    result = parser->parseAll(ARGS << "--jobs=2");
+    QCOMPARE(result.values("jobs"), QStringList() << "2" << "8");
+
+    // Commands are not run with the environment of this process.
+    result = parser->parseAllCommand("_cmd --jobs=2");
+    QCOMPARE(result.values("jobs"), QStringList() << "2");
+
+    // Settings keep their values, but the command line still wins.
+    Settings settings("environment");
+    settings.setValue("jobs", 4);
+    parser->setSettings(&settings);
+    parser->setEnvironmentPrecedence(
+                CommandLineParser::EnvironmentUnderSettings);
+    QVERIFY(parser->parse(ARGS << "--no-dry-run"));
+    QCOMPARE(settings.value("jobs"), QVariant(4));
+    QCOMPARE(settings.value("color"), QVariant("never"));
+    QCOMPARE(settings.value("dry-run"), QVariant(false));
+}
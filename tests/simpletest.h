@@ -7,10 +7,40 @@ class SimpleTest : public QCliTest
 {
     Q_OBJECT
 
+public:
+    void record(CommandLineParser *parser,
+                CommandLineParser::ParsingResult result,
+                const QString &name, QVariant value, bool *stop);
+
+public slots:
+    void recordSlot(CommandLineParser *parser,
+                    CommandLineParser::ParsingResult result,
+                    const QString &name, QVariant value, bool *stop);
+
 private slots:
     void testRequired();
     void testOptional();
     void testSwitch();
+    void testOptionTable();
+    void testManyOptions();
+    void testAbbreviations();
+    void testGroups();
+    void testCallbacks();
+    void testParseResult();
+    void testBinding();
+    void testResponseFiles();
+    void testFeed();
+    void testParallel();
+    void testLongTokens();
+    void testStatistics();
+    void testConcurrentParsing();
+    void testCommandStrings();
+    void testSubcommands();
+    void testCompletion();
+    void testEnvironment();
+
+private:
+    QStringList recorded;
 };
 
 
@@ -1,4 +1,5 @@
 #include <QCoreApplication>
+#include "settingstest.h"
 #include "simpletest.h"
 
 #define RUN(klass, argc, argv) \
@@ -15,6 +16,7 @@ int main(int argc, char *argv[])
 
     int status = 0;
     RUN(SimpleTest, argc, argv)
+    RUN(SettingsTest, argc, argv)
     return status;
 }
 
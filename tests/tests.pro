@@ -8,6 +8,12 @@ CONFIG   -= app_bundle
 
 TEMPLATE  = app
 
+# Tests see the statistics counters; benchmarks measure without them.
+CONFIG   += qcli_statistics
+
+# testConcurrentParsing is best run under ThreadSanitizer, e.g. with
+# qmake CONFIG+=sanitizer CONFIG+=sanitize_thread (Qt 5.6 or later).
+
 include(../qcli.pri)
 
 INCLUDEPATH += $$PWD/../src
@@ -17,8 +23,10 @@ DEFINES += SRCDIR=\\\"$$PWD/../src\\\"
 SOURCES += \
     test_main.cpp \
     simpletest.cpp \
+    settingstest.cpp \
     qclitest.cpp
 
 HEADERS += \
     simpletest.h \
+    settingstest.h \
     qclitest.h